@@ -32,6 +32,7 @@
 
 #include <data/LibraryT.hpp>
 #include <parallel/TaskletRunner.hpp>
+#include <parallel/TaskletScheduler.hpp>
 
 #include <QtCore/QHash>
 
@@ -69,9 +70,46 @@ public:
 
     template< typename T >
     static void RegisterTaskletRunner( Kore::parallel::TaskletRunner* runner )
-        { T::StaticMetaTasklet()->registerTaskletRunner( runner ); }
-    static void RunTasklet( Kore::parallel::Tasklet* tasklet,
-                            Kore::parallel::TaskletRunner::RunMode mode );
+        { AddTaskletRunner( T::StaticMetaTasklet(), runner ); }
+    static kbool RunTasklet( Kore::parallel::Tasklet* tasklet,
+                             Kore::parallel::TaskletRunner::RunMode mode,
+                             Kore::parallel::TaskletRunner::Priority priority
+                                = Kore::parallel::TaskletRunner::InheritPriority,
+                             kint deadline = -1 );
+    // Returns the tasklets rejected by the queue policy, none if all ran.
+    static QList< Kore::parallel::Tasklet* > RunTasklets(
+                              const QList< Kore::parallel::Tasklet* >& tasklets,
+                              Kore::parallel::TaskletRunner::RunMode mode,
+                              Kore::parallel::TaskletRunner::Priority priority
+                                = Kore::parallel::TaskletRunner::InheritPriority,
+                              kint deadline = -1 );
+    template< typename Iterator >
+    static QList< Kore::parallel::Tasklet* > RunTasklets(
+                              Iterator begin, Iterator end,
+                              Kore::parallel::TaskletRunner::RunMode mode,
+                              Kore::parallel::TaskletRunner::Priority priority
+                                = Kore::parallel::TaskletRunner::InheritPriority,
+                              kint deadline = -1 )
+    {
+        QList< Kore::parallel::Tasklet* > tasklets;
+        for( ; begin != end; ++begin )
+        {
+            tasklets.append( *begin );
+        }
+        return RunTasklets( tasklets, mode, priority, deadline );
+    }
+    static kint RunTaskletAfter( Kore::parallel::Tasklet* tasklet, kint delay,
+                                 Kore::parallel::TaskletRunner::Priority priority
+                                    = Kore::parallel::TaskletRunner::NormalPriority );
+    static kint RunTaskletEvery( Kore::parallel::Tasklet* tasklet, kint period,
+                                 Kore::parallel::TaskletRunner::Priority priority
+                                    = Kore::parallel::TaskletRunner::NormalPriority );
+    static kbool CancelTimer( kint timer );
+    static kbool RunJob( Kore::parallel::Job* job,
+                         Kore::parallel::TaskletRunner::RunMode mode,
+                         Kore::parallel::TaskletRunner::Priority priority
+                            = Kore::parallel::TaskletRunner::InheritPriority );
+    static Kore::parallel::TaskletScheduler* Scheduler();
 
     static Kore::data::MetaBlock* GetMetaBlock( const QString& name );
     static Kore::data::MetaBlock* GetMetaBlock( khash blockTypeHash );
@@ -81,8 +119,18 @@ public:
 
     static KoreEngine* Instance();
 
+private:
+    static void AddTaskletRunner( const Kore::parallel::MetaTasklet* metaTasklet,
+                                  Kore::parallel::TaskletRunner* runner );
+    static const Kore::parallel::TaskletRunner* HedgingRunner(
+            Kore::parallel::Tasklet* tasklet,
+            const Kore::parallel::TaskletRunner* runner, kint* delay );
+    static kint BatchSize( Kore::parallel::Tasklet* tasklet,
+                           const Kore::parallel::TaskletRunner* runner );
+
 private:
     Kore::data::LibraryT< Kore::plugin::Module >    _modules;
+    Kore::parallel::TaskletScheduler                _scheduler;
     QHash< QString, Kore::data::MetaBlock* >        _metaBlocksStringHash;
     QHash< khash, Kore::data::MetaBlock* >          _metaBlocksHashHash;
 
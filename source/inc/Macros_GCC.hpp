@@ -29,3 +29,6 @@
 #pragma once
 
 #define	_K_SSE_ALIGNED		__attribute__((aligned (_K_SSE_ALIGNMENT)))
+
+/* Thread local storage */
+#define	_K_THREAD_LOCAL		__thread
@@ -0,0 +1,108 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <KoreExport.hpp>
+#include <Types.hpp>
+
+#include <QtCore/QAtomicInt>
+
+namespace Kore { namespace parallel {
+
+/*!
+ * @class BoundedQueue
+ *
+ * @brief   Fixed capacity, lock-free queue for any number of producers and
+ *          consumers.
+ *
+ * The items are stored in a ring of cells, each with a sequence number telling
+ * whether it is ready to be written or read at a given position. Producers and
+ * consumers only compete on their own position with a compare and swap, a full
+ * or empty queue is detected without any lock nor any wait.
+ *
+ * The capacity is rounded up to the next power of two.
+ */
+template< typename T >
+class BoundedQueue
+{
+public:
+    /*!
+     * Constructor.
+     * @param capacity minimum number of items the queue can hold, at least 2.
+     */
+    explicit BoundedQueue( kint capacity );
+    ~BoundedQueue();
+
+    /*!
+     * @return the maximum number of items in the queue.
+     */
+    inline kint capacity() const { return _mask + 1; }
+    /*!
+     * @return the number of items in the queue, approximate while it is used.
+     */
+    kint size() const;
+
+    /*!
+     * Append an item.
+     * @param item the item to append.
+     * @return true if the item was appended, false if the queue is full.
+     */
+    kbool tryPush( const T& item );
+    /*!
+     * Take the oldest item.
+     * @param item set to the item taken.
+     * @return true if an item was taken, false if the queue is empty.
+     */
+    kbool tryPop( T& item );
+
+private:
+    struct Cell
+    {
+        QAtomicInt  sequence;
+        T           item;
+    };
+
+    static kint Distance( kint sequence, kuint position );
+
+private:
+    Cell*       _cells;
+    kint        _mask;
+    QAtomicInt  _size;
+    // Each position on its own cache line, producers and consumers do not
+    // invalidate each other.
+    char        _padding0[ 64 ];
+    QAtomicInt  _enqueue;
+    char        _padding1[ 64 ];
+    QAtomicInt  _dequeue;
+    char        _padding2[ 64 ];
+};
+
+}}
+
+#include <src/parallel/BoundedQueue.cxx>
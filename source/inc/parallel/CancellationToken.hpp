@@ -0,0 +1,159 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <KoreExport.hpp>
+#include <Types.hpp>
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+
+namespace Kore { namespace parallel {
+
+/*!
+ * @class CancellationToken
+ *
+ * @brief   Cancellation flag shared by a group of Tasklet-s.
+ *
+ * A token is created with Create() and copied around (all the copies share
+ * the same flag). Child tokens are canceled along with their parent, but not
+ * the other way around, which allows to cancel a whole operation or only one
+ * of its parts. Canceling is O(1) whatever the number of tasklets involved:
+ * the running tasklets observe it through keepRunning() and the ones that
+ * did not start yet are dropped by the scheduler without running. Whatever
+ * waits on behalf of a tasklet (a timer, another tasklet) may register a
+ * Listener to be interrupted as well.
+ *
+ * A default constructed token is invalid and never canceled.
+ *
+ * @sa Kore::parallel::Tasklet::cancellationToken
+ */
+class KoreExport CancellationToken
+{
+public:
+    /*!
+     * Notified of the cancellation of a token.
+     */
+    class KoreExport Listener
+    {
+    public:
+        virtual ~Listener();
+
+        /*!
+         * Called on the canceling thread, once per canceled token the
+         * listener is registered with: a token and its ancestor canceled both
+         * notify it twice. Implementations should not block, they may
+         * unregister themselves.
+         */
+        virtual void tokenCanceled() = K_NULL;
+    };
+
+private:
+    struct Scope
+    {
+        Scope() : mutex( QMutex::Recursive ) {}
+        QAtomicInt          refs;
+        QAtomicInt          canceled;
+        Scope*              parent;
+        QMutex              mutex;
+        QList< Listener* >  listeners;
+    };
+
+public:
+    /*!
+     * Constructor of an invalid token.
+     */
+    CancellationToken();
+    CancellationToken( const CancellationToken& other );
+    ~CancellationToken();
+
+    CancellationToken& operator=( const CancellationToken& other );
+
+    /*!
+     * Create a new root token.
+     * @return the token.
+     */
+    static CancellationToken Create();
+    /*!
+     * Create a token canceled along with this one.
+     * @return the child token.
+     */
+    CancellationToken createChild() const;
+
+    /*!
+     * @return true if the token was created, false if default constructed.
+     */
+    inline kbool isValid() const { return _scope != K_NULL; }
+
+    /*!
+     * Check whether this token or one of its ancestors was canceled.
+     * @return true if canceled, false otherwise.
+     */
+    inline kbool isCanceled() const
+    {
+        for( const Scope* scope = _scope; scope; scope = scope->parent )
+        {
+            if( scope->canceled != 0 )
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /*!
+     * Cancel this token and all its children.
+     */
+    void cancel();
+
+    /*!
+     * Register a listener, notified when this token or one of its ancestors
+     * is canceled. A past cancellation is not notified, check isCanceled()
+     * once registered.
+     * @param listener the listener.
+     */
+    void addListener( Listener* listener ) const;
+    /*!
+     * Unregister a listener. Once this returns, it is not being notified
+     * anymore.
+     * @param listener the listener.
+     */
+    void removeListener( Listener* listener ) const;
+
+private:
+    explicit CancellationToken( Scope* parent );
+
+    static void Release( Scope* scope );
+
+private:
+    Scope* _scope;
+};
+
+}}
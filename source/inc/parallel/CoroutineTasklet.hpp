@@ -0,0 +1,275 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <parallel/Tasklet.hpp>
+#include <parallel/TaskletObserver.hpp>
+
+/*
+ * Coroutine tasklets require a C++20 compiler, they are simply left out
+ * otherwise.
+ */
+#if defined( __cpp_impl_coroutine ) && ( __cpp_impl_coroutine >= 201902L )
+#   define _K_COROUTINES
+#endif
+
+#ifdef _K_COROUTINES
+
+#include <parallel/CancellationToken.hpp>
+
+#include <QtCore/QMutex>
+#include <QtCore/QSocketNotifier>
+
+#include <coroutine>
+
+namespace Kore { namespace parallel {
+
+/*!
+ * @class CoroutineTasklet
+ *
+ * @brief   A tasklet implemented as a C++20 coroutine.
+ *
+ * The execute() coroutine may co_await the end of other tasklets, delays and
+ * sockets readiness. While it is suspended, no worker thread is blocked; it
+ * is resumed on a worker of the engine's scheduler once the awaited event
+ * occurred.
+ *
+ * Cancellation is observed at each suspension point: a canceled coroutine is
+ * destroyed instead of being resumed (its locals are destructed as usual)
+ * and the tasklet ends as canceled. A pending delay or socket wait is
+ * interrupted right away, an awaited tasklet is canceled in turn. In between
+ * suspension points, the implementation may still check keepRunning().
+ *
+ * @code
+ * CoroutineTasklet::Coroutine Loader::execute()
+ * {
+ *     co_await socketReady( _socket, QSocketNotifier::Read );
+ *     readHeader();
+ *     if( co_await runTasklet( _decoder ) != Completed )
+ *     {
+ *         throw DecodingError(); // Ends the tasklet as failed.
+ *     }
+ *     co_await delay( 100 );
+ * }
+ * @endcode
+ *
+ * Delays and sockets are watched from the application's thread: they need
+ * its event loop to be running.
+ */
+class KoreExport CoroutineTasklet : public Tasklet,
+                                    private CancellationToken::Listener
+{
+public:
+    class Coroutine;
+
+    /*!
+     * Awaiter running a tasklet asynchronously, resumed once it ended with
+     * its final state.
+     */
+    class KoreExport TaskletAwaiter : private TaskletObserver
+    {
+    public:
+        TaskletAwaiter( CoroutineTasklet* coroutine, Tasklet* tasklet );
+
+        inline bool await_ready() const noexcept { return false; }
+        void await_suspend( std::coroutine_handle<> handle );
+        inline kint await_resume() const noexcept { return _state; }
+
+    private:
+        virtual void taskletEnded( Tasklet* tasklet, kint state );
+
+    private:
+        CoroutineTasklet*   _coroutine;
+        Tasklet*            _tasklet;
+        kint                _state;
+    };
+
+    /*!
+     * Awaiter resumed after a delay.
+     */
+    class KoreExport DelayAwaiter
+    {
+    public:
+        DelayAwaiter( CoroutineTasklet* coroutine, kint msecs );
+
+        inline bool await_ready() const noexcept { return _msecs <= 0; }
+        void await_suspend( std::coroutine_handle<> handle );
+        inline void await_resume() const noexcept {}
+
+    private:
+        CoroutineTasklet*   _coroutine;
+        kint                _msecs;
+    };
+
+    /*!
+     * Awaiter resumed once a socket is ready.
+     */
+    class KoreExport SocketAwaiter
+    {
+    public:
+        SocketAwaiter( CoroutineTasklet* coroutine, int socket,
+                       QSocketNotifier::Type type );
+
+        inline bool await_ready() const noexcept { return false; }
+        void await_suspend( std::coroutine_handle<> handle );
+        inline void await_resume() const noexcept {}
+
+    private:
+        CoroutineTasklet*       _coroutine;
+        int                     _socket;
+        QSocketNotifier::Type   _type;
+    };
+
+protected:
+    /*!
+     * Constructor.
+     * @param autoDelete if true, the Tasklet is automatically destroyed when completed.
+     * @return a CoroutineTasklet instance.
+     */
+    CoroutineTasklet( kbool autoDelete = false );
+
+public:
+    virtual ~CoroutineTasklet();
+
+    /*!
+     * Cancel the execution of the coroutine, interrupting what it awaits.
+     */
+    virtual void cancel();
+
+protected:
+    /*!
+     * The coroutine implementing the tasklet. It ends the tasklet as
+     * completed when it returns and as failed if it throws.
+     * @return the coroutine.
+     */
+    virtual Coroutine execute() = K_NULL;
+
+    /*!
+     * Run a tasklet asynchronously and wait for its end.
+     * @param tasklet the tasklet to run.
+     * @return the awaiter, which results in the final state of the tasklet.
+     */
+    TaskletAwaiter runTasklet( Tasklet* tasklet );
+    /*!
+     * Wait for the given delay.
+     * @param msecs the delay in ms.
+     * @return the awaiter.
+     */
+    DelayAwaiter delay( kint msecs );
+    /*!
+     * Wait for a socket to be ready.
+     * @param socket the socket descriptor.
+     * @param type the kind of readiness to wait for.
+     * @return the awaiter.
+     */
+    SocketAwaiter socketReady( int socket, QSocketNotifier::Type type );
+
+    // Tasklet implementation !
+    virtual QString runnerName() const;
+    virtual void run( Tasklet* tasklet ) const;
+
+private:
+    class Reactor;
+    class Resumer;
+    class Notifier;
+
+    void resume();
+    void proceed();
+    void finish( kbool failed );
+    void interrupt();
+
+    // CancellationToken::Listener implementation !
+    virtual void tokenCanceled();
+
+private:
+    std::coroutine_handle<> _handle;
+    QMutex                  _suspensionMutex;
+    Tasklet*                _awaited;   //!< The tasklet awaited, if any
+    kbool                   _reacting;  //!< Awaiting the reactor
+};
+
+/*!
+ * @class CoroutineTasklet::Coroutine
+ *
+ * Return type of the CoroutineTasklet::execute() coroutine.
+ */
+class KoreExport CoroutineTasklet::Coroutine
+{
+public:
+    struct FinalAwaiter;
+
+    struct promise_type
+    {
+        // Receives the tasklet the execute() coroutine is called on.
+        template< class C >
+        promise_type( C& coroutine )
+            : tasklet( &coroutine )
+            , failed( false )
+        {
+        }
+
+        inline Coroutine get_return_object()
+        {
+            return Coroutine(
+                    std::coroutine_handle< promise_type >::from_promise( *this ) );
+        }
+        // Started by the runner, once the handle is stored.
+        inline std::suspend_always initial_suspend() const noexcept
+            { return std::suspend_always(); }
+        FinalAwaiter final_suspend() const noexcept;
+        inline void return_void() {}
+        inline void unhandled_exception() { failed = true; }
+
+        CoroutineTasklet*   tasklet;
+        kbool               failed;
+    };
+
+    struct FinalAwaiter
+    {
+        inline bool await_ready() const noexcept { return false; }
+        void await_suspend( std::coroutine_handle< promise_type > handle ) noexcept;
+        inline void await_resume() const noexcept {}
+    };
+
+public:
+    explicit Coroutine( std::coroutine_handle< promise_type > handle )
+        : _handle( handle )
+    {
+    }
+
+    inline std::coroutine_handle< promise_type > handle() const
+        { return _handle; }
+
+private:
+    std::coroutine_handle< promise_type > _handle;
+};
+
+}}
+
+#endif // _K_COROUTINES
@@ -0,0 +1,114 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <KoreExport.hpp>
+#include <Types.hpp>
+
+#include <cstddef>
+
+namespace Kore {
+
+class KoreEngine;
+
+namespace parallel {
+
+class JobCounter;
+class MetaTasklet;
+class TaskletRunner;
+class TaskletScheduler;
+
+/*!
+ * @class Job
+ *
+ * @brief   A lightweight unit of work, for very fine-grained parallelism.
+ *
+ * Contrary to a Tasklet, a job is not a Block nor a QObject: it has no
+ * signals, no events and no wait condition. Jobs are allocated from pools of
+ * fixed size blocks recycled per thread, run once and are destroyed right
+ * after by the thread that ran them. Completion is tracked through an
+ * optional JobCounter.
+ *
+ * A job may still be implemented by the TaskletRunner-s of a tasklet type: if
+ * metaTasklet() is specified, the runner is selected by that MetaTasklet and
+ * its TaskletRunner::runJob() is called instead of run().
+ *
+ * @sa Kore::parallel::JobCounter
+ * @sa Kore::KoreEngine::RunJob
+ */
+class KoreExport Job
+{
+    friend class Kore::KoreEngine;
+    friend class TaskletScheduler;
+
+public:
+    /*!
+     * Constructor.
+     * @param counter the counter to account this job in, if any.
+     */
+    Job( JobCounter* counter = K_NULL );
+    virtual ~Job();
+
+    static void* operator new( std::size_t size );
+    static void operator delete( void* block, std::size_t size );
+
+    /*!
+     * Meta tasklet whose runners implement this job.
+     * @return the meta tasklet, K_NULL (the default) if the job runs itself.
+     */
+    virtual const MetaTasklet* metaTasklet() const;
+    /*!
+     * Hint about the size of the input of the job, @see Tasklet::sizeHint
+     * @return the input size hint, 0 by default.
+     */
+    virtual kuint64 sizeHint() const;
+
+    /*!
+     * Default implementation of the job.
+     */
+    virtual void run() = K_NULL;
+
+private:
+    /*!
+     * Run the job with the given runner and destroy it.
+     * @param job the job.
+     * @param runner the runner, K_NULL to use the job's own implementation.
+     */
+    static void Execute( Job* job, const TaskletRunner* runner );
+    /*!
+     * Destroy the job and release its counter, whether it ran or not.
+     * @param job the job.
+     */
+    static void Discard( Job* job );
+
+private:
+    JobCounter* _counter;
+};
+
+}}
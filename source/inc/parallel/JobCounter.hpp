@@ -0,0 +1,91 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <KoreExport.hpp>
+#include <Types.hpp>
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+
+namespace Kore { namespace parallel {
+
+class Job;
+
+/*!
+ * @class JobCounter
+ *
+ * @brief   Counts the Job-s that are not finished yet.
+ *
+ * Every job created with a counter increments it and decrements it once it
+ * has been run and destroyed. Waiting on the counter spins briefly on the
+ * atomic count before falling back to a wait condition, which is only
+ * signaled when somebody actually sleeps on it. The last job is accounted
+ * under the lock, so that the counter may be destroyed as soon as wait()
+ * returns.
+ *
+ * @sa Kore::parallel::Job
+ */
+class KoreExport JobCounter
+{
+    friend class Job;
+
+public:
+    JobCounter();
+    ~JobCounter();
+
+    /*!
+     * @return the number of jobs not finished yet.
+     */
+    kint pending() const;
+    /*!
+     * @return true if all the jobs are finished, false otherwise.
+     */
+    kbool isDone() const;
+
+    /*!
+     * Wait for all the jobs to be finished.
+     * @param timeout MAX number of ms to wait. If set to ULONG_MAX, no timeout.
+     * @return true if all the jobs are finished, false if the wait timed out.
+     */
+    kbool wait( kulong timeout = ULONG_MAX );
+
+private:
+    void add();
+    void done();
+
+private:
+    QAtomicInt      _pending;
+    QAtomicInt      _waiters;
+    QMutex          _mutex;
+    QWaitCondition  _condition;
+};
+
+}}
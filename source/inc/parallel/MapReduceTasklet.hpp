@@ -0,0 +1,152 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <KoreExport.hpp>
+
+#include <data/Library.hpp>
+
+#include <parallel/Tasklet.hpp>
+
+#include <QtCore/QAtomicInt>
+
+namespace Kore { namespace parallel {
+
+/*!
+ * @class MapReduceTasklet
+ *
+ * @brief   A MapReduceTasklet maps every block of a Library subtree to a
+ *          partial result and reduces the partial results into one, spreading
+ *          the walk over all the workers of the TaskletScheduler.
+ *
+ * The children of each library are split in halves the same way as the
+ * indexes of a RangeTasklet, and nested libraries are walked by the worker
+ * finding them, which splits them in turn: idle workers steal the biggest
+ * pending pieces of the tree whatever its shape.
+ *
+ * Each worker maps the blocks into a partial result of its own, the partial
+ * results are only reduced once the whole subtree has been walked: there is no
+ * locking at all, nor any sharing of cache lines between the workers.
+ *
+ * The blocks are the same as the ones of Library::findChildren, the library
+ * must not be modified while the tasklet is running. Canceling it skips the
+ * blocks not mapped yet, the result is then partial.
+ *
+ * This is the untyped part of the map-reduce, use MapReduceTaskletT to
+ * implement one.
+ *
+ * @sa Kore::parallel::MapReduceTaskletT
+ */
+class KoreExport MapReduceTasklet : public Tasklet
+{
+    Q_OBJECT
+
+    class Walk;
+
+protected:
+    /*!
+     * Constructor.
+     * @param target root of the subtree to walk.
+     * @param typed if true, the children of the target are all of the mapped
+     * type and are not checked.
+     * @param depth maximum depth of the walk, the whole subtree if negative.
+     * @param grain maximum number of children walked in a row by a worker,
+     * automatic if lower than 1.
+     * @param autoDelete if true, the Tasklet is automatically destroyed when completed.
+     * @return a MapReduceTasklet instance.
+     */
+    MapReduceTasklet( Kore::data::Library* target, kbool typed,
+                      kint depth = -1, kint grain = 0,
+                      kbool autoDelete = false );
+
+public:
+    /*!
+     * @return the root of the walked subtree.
+     */
+    inline Kore::data::Library* target() const { return _target; }
+    /*!
+     * @return the maximum depth of the walk, negative for the whole subtree.
+     */
+    inline kint depth() const { return _depth; }
+
+    /*!
+     * @return the grain, 0 if automatic.
+     */
+    inline kint grain() const { return _grain; }
+    /*!
+     * Set the grain. This has no effect on a running tasklet.
+     * @param grain maximum number of children walked in a row by a worker,
+     * automatic if lower than 1.
+     */
+    void grain( kint grain );
+
+protected:
+    /*!
+     * Reset the partial results before a run.
+     * @param count the number of partial results, one per worker and one for
+     * the thread running the tasklet.
+     */
+    virtual void resetPartials( kint count ) = K_NULL;
+    /*!
+     * Map a block into a partial result, if it is of the mapped type.
+     *
+     * This is called concurrently from all the worker threads, but a partial
+     * result is only ever used by one thread at a time.
+     * @param block the block to map.
+     * @param partial index of the partial result to map into.
+     * @param typed true if the block is known to be of the mapped type.
+     */
+    virtual void mapBlock( Kore::data::Block* block, kint partial,
+                           kbool typed ) = K_NULL;
+    /*!
+     * Reduce the partial results, once all the blocks were mapped.
+     */
+    virtual void reducePartials() = K_NULL;
+
+    virtual QString runnerName() const;
+    virtual void run( Tasklet* tasklet ) const;
+
+private:
+    kint partial() const;
+    void walk( Kore::data::Library* library, kint begin, kint end,
+               kint depth );
+    void leave();
+
+private:
+    Kore::data::Library*    _target;
+    kbool                   _typed;
+    kint                    _depth;
+    kint                    _grain;
+
+    // Execution
+    kint                    _partials;
+    QAtomicInt              _pending;   //!< Walks not over yet
+};
+
+}}
@@ -0,0 +1,186 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <data/LibraryT.hpp>
+
+#include <parallel/MapReduceTasklet.hpp>
+
+namespace Kore { namespace parallel {
+
+/*!
+ * @class MapReduceTaskletT
+ *
+ * A MapReduceTasklet mapping the T blocks of a subtree to a result of type R:
+ * map() accumulates a block into a partial result, reduce() accumulates a
+ * partial result into the final one. All of them start as copies of the
+ * initial value, which must be neutral for the reduction (0 for a sum...).
+ *
+ * The blocks are filtered with Block::fastInherits, except for the children of
+ * a LibraryT< T > target that all are T blocks already.
+ *
+ * Counting the items of a tree, for instance:
+ * @code
+ * struct Count
+ * {
+ *     void operator()( Item*, kuint64& count ) const { ++count; }
+ * };
+ * struct Sum
+ * {
+ *     void operator()( kuint64& total, const kuint64& count ) const
+ *         { total += count; }
+ * };
+ *
+ * MapReduceTaskletT< Item, kuint64 >* count =
+ *         MapReduceTaskletT< Item, kuint64 >::MapReduce( tree, 0, Count(), Sum() );
+ * KoreEngine::RunTasklet( count, TaskletRunner::Synchronous );
+ * count->waitForFinished();
+ * @endcode
+ *
+ * @sa Kore::parallel::MapReduceFunctorTasklet
+ */
+template< typename T, typename R >
+class MapReduceTaskletT : public MapReduceTasklet
+{
+protected:
+    /*!
+     * Constructor for a typed library, its children are not checked.
+     * @param target root of the subtree to walk.
+     * @param initial initial value of the result and of the partial results.
+     * @param depth maximum depth of the walk, the whole subtree if negative.
+     * @param grain maximum number of children walked in a row by a worker,
+     * automatic if lower than 1.
+     * @param autoDelete if true, the Tasklet is automatically destroyed when completed.
+     * @return a MapReduceTaskletT instance.
+     */
+    MapReduceTaskletT( Kore::data::LibraryT< T >* target,
+                       const R& initial = R(), kint depth = -1,
+                       kint grain = 0, kbool autoDelete = false );
+    /*!
+     * Constructor for any library, the T blocks are found with fastInherits.
+     * @param target root of the subtree to walk.
+     * @param initial initial value of the result and of the partial results.
+     * @param depth maximum depth of the walk, the whole subtree if negative.
+     * @param grain maximum number of children walked in a row by a worker,
+     * automatic if lower than 1.
+     * @param autoDelete if true, the Tasklet is automatically destroyed when completed.
+     * @return a MapReduceTaskletT instance.
+     */
+    MapReduceTaskletT( Kore::data::Library* target,
+                       const R& initial = R(), kint depth = -1,
+                       kint grain = 0, kbool autoDelete = false );
+
+public:
+    virtual ~MapReduceTaskletT();
+
+    /*!
+     * @return the result, once the tasklet is finished.
+     */
+    inline const R& result() const { return _result; }
+
+    template< typename M, typename F >
+    static MapReduceTaskletT< T, R >* MapReduce(
+            Kore::data::LibraryT< T >* target, const R& initial,
+            M map, F reduce, kint depth = -1, kint grain = 0,
+            kbool autoDelete = false );
+    template< typename M, typename F >
+    static MapReduceTaskletT< T, R >* MapReduce(
+            Kore::data::Library* target, const R& initial,
+            M map, F reduce, kint depth = -1, kint grain = 0,
+            kbool autoDelete = false );
+
+protected:
+    /*!
+     * Map a block into a partial result.
+     *
+     * This is called concurrently from all the worker threads, but a partial
+     * result is only ever used by one thread at a time.
+     * @param block the block to map.
+     * @param partial the partial result of the calling thread.
+     */
+    virtual void map( T* block, R& partial ) = K_NULL;
+    /*!
+     * Reduce a partial result into the result, from a single thread.
+     * @param result the result.
+     * @param partial a partial result.
+     */
+    virtual void reduce( R& result, const R& partial ) = K_NULL;
+
+    virtual void resetPartials( kint count );
+    virtual void mapBlock( Kore::data::Block* block, kint partial,
+                           kbool typed );
+    virtual void reducePartials();
+
+private:
+    struct Slot
+    {
+        R       value;
+        char    padding[ 64 ];  //!< No cache line shared between the workers
+    };
+
+private:
+    R       _initial;
+    R       _result;
+    Slot*   _slots;
+    kint    _slotCount;
+};
+
+/*!
+ * @class MapReduceFunctorTasklet
+ *
+ * A MapReduceTaskletT calling functors to map and to reduce: map( T*, R& )
+ * and reduce( R&, const R& ). The functors are shared by all the workers.
+ *
+ * @sa Kore::parallel::MapReduceTaskletT::MapReduce
+ */
+template< typename T, typename R, typename M, typename F >
+class MapReduceFunctorTasklet : public MapReduceTaskletT< T, R >
+{
+public:
+    MapReduceFunctorTasklet( Kore::data::LibraryT< T >* target,
+                             const R& initial, M map, F reduce,
+                             kint depth = -1, kint grain = 0,
+                             kbool autoDelete = false );
+    MapReduceFunctorTasklet( Kore::data::Library* target,
+                             const R& initial, M map, F reduce,
+                             kint depth = -1, kint grain = 0,
+                             kbool autoDelete = false );
+
+protected:
+    virtual void map( T* block, R& partial );
+    virtual void reduce( R& result, const R& partial );
+
+private:
+    M _map;
+    F _reduce;
+};
+
+}}
+
+#include <src/parallel/MapReduceTaskletT.cxx>
@@ -32,12 +32,19 @@
 
 #include <data/MetaBlock.hpp>
 
+#include <QtCore/QAtomicInt>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QReadWriteLock>
+#include <QtCore/QVector>
+
 namespace Kore {
 
 class KoreEngine;
 
 namespace parallel {
 
+class Tasklet;
 class TaskletRunner;
 
 /*!
@@ -46,6 +53,12 @@ class TaskletRunner;
  * This class is a meta object for a tasklet. Its main role is to gather
  * the available TaskletRunner-s for the Tasklet it describes.
  *
+ * It also learns which runner is actually the fastest: the execution time of
+ * each completed run is recorded per runner and per input size bucket (the
+ * base 2 logarithm of Tasklet::sizeHint()). The static performance score only
+ * orders the runners that were not measured yet. Past the first runs of a
+ * size bucket, only a sample of the runs is timed and recorded.
+ *
  * This class should not be used on its own !
  *
  * @sa Kore::parallel::Tasklet
@@ -60,6 +73,35 @@ class KoreExport MetaTasklet : public Kore::data::MetaBlock
     Q_OBJECT
 
     friend class Kore::KoreEngine;
+    friend class Job;
+    friend class Tasklet;
+    friend class TaskletScheduler;
+
+public:
+    /*!
+     * Number of input size buckets, one per power of 2.
+     */
+    static const kint SizeBuckets = 65;
+    /*!
+     * Number of recent execution times kept per input size bucket to compute
+     * the hedging delay.
+     */
+    static const kint HedgingWindow = 64;
+    /*!
+     * Default maximum number of tasklets per batch.
+     */
+    static const kint DefaultBatchSize = 64;
+
+    /*!
+     * Measured execution profile of a runner for a given input size bucket.
+     */
+    struct RunnerProfile
+    {
+        const TaskletRunner* runner;    //!< The measured runner
+        kint bucket;                    //!< The input size bucket
+        kuint64 runs;                   //!< The number of measured runs
+        kuint64 averageTime;            //!< Average execution time in ns
+    };
 
 protected:
     /*!
@@ -93,10 +135,181 @@ public:
         return _runners.isEmpty() ? K_NULL : _runners.first();
     }
 
+    /*!
+     * Select the runner to use for a tasklet of the given input size.
+     *
+     * Runners that were never measured for that size bucket are tried first,
+     * by decreasing performance score, one probe run at a time: until the
+     * probe completes, the other selections ignore the unmeasured runners.
+     * Then the runner with the lowest average execution time wins, except for
+     * the periodic exploration runs.
+     *
+     * @param sizeHint the input size hint of the tasklet.
+     * @param probe set to true if the selection is a probe run, which must
+     *        not be reused for other tasklets.
+     * @return the selected runner or K_NULL if there is none.
+     */
+    const TaskletRunner* selectRunner( kuint64 sizeHint,
+                                       kbool* probe = K_NULL ) const;
+
+    /*!
+     * Set the exploration period: one selection out of period runs the next
+     * runner in turn instead of the fastest one, so that the profile keeps up
+     * with changing conditions.
+     * @param period the exploration period, 0 to disable exploration.
+     */
+    void explorationPeriod( kint period );
+    /*!
+     * @return the exploration period, 0 if disabled.
+     */
+    kint explorationPeriod() const;
+
+    /*!
+     * Set the hedging percentile, to bound the latency of the tasklets.
+     *
+     * A hedged tasklet is not run itself: a copy of it (@see
+     * Tasklet::hedgedCopy) is run by the selected runner and, if it is not
+     * finished once the given percentile of the recent execution times of its
+     * size bucket elapsed, a second copy is run by the next best runner. The
+     * first copy to complete wins, the other one is canceled through
+     * keepRunning().
+     *
+     * Only the asynchronous executions are hedged, once enough execution
+     * times were measured and if there are at least two runners.
+     * @param percentile the percentile in ]0, 100], 0 to disable hedging.
+     */
+    void hedgingPercentile( kint percentile );
+    /*!
+     * @return the hedging percentile, 0 if disabled.
+     */
+    kint hedgingPercentile() const;
+
+    /*!
+     * Get the hedging delay for a tasklet of the given input size.
+     * @param sizeHint the input size hint of the tasklet.
+     * @return the delay in ns, -1 if the tasklet should not be hedged.
+     */
+    kint64 hedgingDelay( kuint64 sizeHint ) const;
+    /*!
+     * Select the runner hedging the given one: the measured fastest of the
+     * others, by performance score if none was measured.
+     * @param sizeHint the input size hint of the tasklet.
+     * @param runner the runner to hedge.
+     * @return the hedging runner or K_NULL if there is none.
+     */
+    const TaskletRunner* hedgingRunner( kuint64 sizeHint,
+                                        const TaskletRunner* runner ) const;
+
+    /*!
+     * Set how the asynchronous executions are fused into batches, for the
+     * runners processing several tasklets at once (@see
+     * TaskletRunner::maxBatchSize).
+     *
+     * A tasklet run on its own waits for at most the given window for others
+     * to join its batch, the batch is dispatched as soon as it is full. The
+     * tasklets run together with KoreEngine::RunTasklets are batched right
+     * away. Tasklets with a deadline are never batched.
+     * @param size maximum number of tasklets per batch, 1 to disable batching.
+     * @param window maximum time in ms a tasklet waits for its batch to fill,
+     * 0 not to wait.
+     */
+    void batching( kint size, kint window );
+    /*!
+     * @return the maximum number of tasklets per batch.
+     */
+    kint batchSize() const;
+    /*!
+     * @return the maximum time in ms a tasklet waits for its batch to fill.
+     */
+    kint batchWindow() const;
+
+    /*!
+     * Bound the number of tasklets of this type run at once by the scheduler
+     * workers, for the tasklets contending on a shared resource such as a
+     * disk.
+     *
+     * The workers never wait for a slot: a tasklet picked over the limit is
+     * set aside and queued again once another one of its type ends, the
+     * workers run other tasks meanwhile. The tasklets run on the submitting
+     * thread by the queue policy are bound as well, each hedged copy counts
+     * as a run and a batch as a single one. Only the synchronous runs are
+     * not bound.
+     * @param limit the maximum number of tasklets run at once, 0 for no limit.
+     */
+    void maxConcurrency( kint limit );
+    /*!
+     * @return the maximum number of tasklets run at once, 0 if there is no
+     * limit.
+     */
+    kint maxConcurrency() const;
+    /*!
+     * @return the number of tasklets of this type being run by the scheduler
+     * workers.
+     */
+    kint inFlight() const;
+
+    /*!
+     * Get the learned execution profile.
+     * @return one entry per runner and measured size bucket.
+     */
+    QList< RunnerProfile > profile() const;
+    /*!
+     * Forget everything that was learned.
+     */
+    void resetProfile();
+
+    /*!
+     * @return the size bucket of the given input size hint.
+     */
+    static kint SizeBucket( kuint64 sizeHint );
+    /*!
+     * Check whether the host CPU has all the features a runner requires.
+     * @param runner the runner.
+     * @return true if the runner can run on this host, false otherwise.
+     */
+    static kbool IsSupported( const TaskletRunner* runner );
+
     virtual QString blockIconPath() const { return QString(); }
 
+private:
+    kbool sampleRun( kuint64 sizeHint ) const;
+    void recordRun( const TaskletRunner* runner,
+                    kuint64 sizeHint, kuint64 time ) const;
+    void recordLatency( kuint64 sizeHint, kuint64 time ) const;
+    void addLatency( kint bucket, kuint64 time ) const;
+
+private:
+    struct Measure
+    {
+        Measure() : runs( 0 ), average( 0.0 ) {}
+        kuint64 runs;
+        kdouble average;
+    };
+
+    typedef QHash< const TaskletRunner*, QVector< Measure > > Profile;
+
+    struct Latencies
+    {
+        Latencies() : next( 0 ) {}
+        QVector< kuint64 > times;   //!< Ring of the recent times in ns
+        kint next;
+    };
+
 private:
     QList< const TaskletRunner* > _runners;
+    mutable QReadWriteLock _profileLock;
+    mutable Profile _profile;
+    mutable QHash< kint, Latencies > _latencies;
+    mutable QAtomicInt _selections;
+    mutable QAtomicInt _recorded[ SizeBuckets ];
+    mutable QAtomicInt _probe;  //!< Start of the probe run in s, 0 if none
+    QElapsedTimer _clock;
+    kint _explorationPeriod;
+    kint _hedgingPercentile;
+    kint _batchSize;
+    kint _batchWindow;
+    kint _maxConcurrency;
+    mutable QAtomicInt _inFlight;
 };
 
 }}
@@ -0,0 +1,225 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <KoreExport.hpp>
+
+#include <parallel/Tasklet.hpp>
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+
+namespace Kore { namespace parallel {
+
+/*!
+ * @class PipelineTasklet
+ *
+ * @brief   A PipelineTasklet streams items through a chain of stages, all
+ *          the stages running at the same time on the workers of the
+ *          TaskletScheduler.
+ *
+ * The first stage produces the items, every other stage processes the items
+ * of the previous one. Consecutive stages are connected by bounded lock-free
+ * queues and each stage runs on up to a given number of workers at once.
+ *
+ * A stage only takes an item once it has a free slot in the queue of the next
+ * stage: when a stage is too slow, its queue fills up and the upstream stages
+ * stop, without ever blocking a worker. They are scheduled again as soon as
+ * the queue is consumed. Likewise, a first stage starved of input (which it
+ * may get from outside) is parked until supplied() or exhaust() is called.
+ *
+ * The throughput and the queue occupancy of each stage can be sampled while
+ * the pipeline runs, to find the bottleneck stages.
+ *
+ * The tasklet ends once every item went through the last stage, which happens
+ * on the workers even when it is run synchronously. Canceling it drops the
+ * items still in the queues.
+ *
+ * @sa Kore::parallel::PipelineTaskletT
+ */
+class KoreExport PipelineTasklet : public Tasklet,
+                                   private CancellationToken::Listener
+{
+    Q_OBJECT
+
+    class StageTask;
+    struct Stage;
+
+public:
+    /*!
+     * Statistics of a stage.
+     */
+    struct StageStats
+    {
+        QString     name;           //!< Name of the stage
+        kint        parallelism;    //!< Maximum number of workers
+        kint        active;         //!< Number of workers running it
+        kuint64     processed;      //!< Number of items it went through
+        kdouble     throughput;     //!< Items per second since the start
+        kint        queued;         //!< Items waiting in its input queue
+        kint        capacity;       //!< Capacity of its input queue
+        kuint64     stalls;         //!< Times it stopped on a full output queue
+    };
+
+    static const kint DefaultCapacity = 64;
+
+protected:
+    /*!
+     * Constructor.
+     * @param autoDelete if true, the Tasklet is automatically destroyed when completed.
+     * @return a PipelineTasklet instance.
+     */
+    PipelineTasklet( kbool autoDelete = false );
+
+public:
+    virtual ~PipelineTasklet();
+
+    /*!
+     * Cancel the pipeline, even while its first stage is parked.
+     */
+    virtual void cancel();
+
+    /*!
+     * @return the number of stages.
+     */
+    kint stageCount() const;
+    /*!
+     * Sample the statistics of a stage, this can be called at any time.
+     * @param stage index of the stage.
+     * @return the statistics of the stage.
+     */
+    StageStats stageStats( kint stage ) const;
+
+protected:
+    /*!
+     * Outcome of a step of a stage.
+     */
+    enum Step
+    {
+        Processed,  //!< An item went through the stage
+        Starved,    //!< No item to process, parks the first stage
+        Blocked     //!< No room in the output queue
+    };
+
+    /*!
+     * Append a stage, not while the pipeline is running.
+     * @param parallelism maximum number of workers running the stage at once.
+     * @param capacity capacity of the queue feeding the stage, not used for the
+     * first stage.
+     */
+    void appendStage( kint parallelism, kint capacity );
+
+    /*!
+     * Move a single item through a stage, with the helpers below.
+     *
+     * This is called concurrently from the workers, for all the stages.
+     * @param stage index of the stage.
+     * @return the outcome of the step.
+     */
+    virtual Step step( kint stage ) = K_NULL;
+    /*!
+     * @param stage index of the stage.
+     * @return the name of the stage.
+     */
+    virtual QString stageName( kint stage ) const = K_NULL;
+    /*!
+     * Drop all the items in the queues, before the pipeline is run.
+     */
+    virtual void clear() = K_NULL;
+
+    /*!
+     * Reserve a slot in the output queue of a stage.
+     * @param stage index of the stage, not the last one.
+     * @return true if a slot was reserved, false if the queue is full.
+     */
+    kbool reserve( kint stage );
+    /*!
+     * Give back a slot reserved in the output queue of a stage.
+     */
+    void unreserve( kint stage );
+    /*!
+     * @return true if the first stage produced its last item.
+     */
+    kbool exhausted() const;
+    /*!
+     * Notify that the first stage has no more items to produce.
+     */
+    void exhaust();
+    /*!
+     * Notify that the first stage has new input to produce items from, after
+     * it was starved. This can be called from any thread.
+     */
+    void supplied();
+    /*!
+     * Notify that the first stage produced an item.
+     */
+    void produced();
+    /*!
+     * Notify that an item was pushed to the output queue of a stage, using a
+     * reserved slot.
+     */
+    void pushed( kint stage );
+    /*!
+     * Notify that an item was taken from the input queue of a stage.
+     */
+    void popped( kint stage );
+    /*!
+     * Notify that an item left the pipeline, dropped by a stage or through
+     * the last stage.
+     */
+    void consumed();
+
+    virtual QString runnerName() const;
+    virtual void run( Tasklet* tasklet ) const;
+
+private:
+    void start();
+    void pump( kint stage );
+    void drain( kint stage );
+    void leave();
+    void unpark();
+
+    // CancellationToken::Listener implementation !
+    virtual void tokenCanceled();
+
+private:
+    QList< Stage* >         _stages;
+
+    // Execution
+    QAtomicInt              _running;   //!< Stage tasks, including the starter
+    QAtomicInt              _exhausted;
+    QAtomicInt              _parked;    //!< The first stage awaits input
+    QAtomicInt              _supplies;  //!< Times new input was supplied
+    QAtomicInt              _inFlight;  //!< Items produced and not consumed
+    QElapsedTimer           _clock;
+};
+
+}}
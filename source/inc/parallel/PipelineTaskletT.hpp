@@ -0,0 +1,109 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <parallel/BoundedQueue.hpp>
+#include <parallel/PipelineTasklet.hpp>
+
+namespace Kore { namespace parallel {
+
+/*!
+ * @class PipelineStage
+ *
+ * A PipelineStage implements one step of a PipelineTaskletT, the same way a
+ * TaskletRunner implements the operations of a tasklet. A single stage may be
+ * used at the same time by different workers, process() is const to make sure
+ * that no modifications whatsoever are made to the instance.
+ */
+template< typename T >
+class PipelineStage
+{
+public:
+    virtual ~PipelineStage() {}
+
+    virtual QString stageName() const = K_NULL;
+
+    /*!
+     * Process an item.
+     *
+     * The first stage of a pipeline produces the items: it fills the item in
+     * and returns false once there is nothing left to produce. Any other stage
+     * transforms the item in place and returns false to drop it.
+     *
+     * @param item the item to produce or to process.
+     * @return true if the item goes on to the next stage, false otherwise.
+     */
+    virtual kbool process( T& item ) const = K_NULL;
+};
+
+/*!
+ * @class PipelineTaskletT
+ *
+ * A PipelineTasklet moving items of type T through PipelineStage-s:
+ *
+ * @code
+ * PipelineTaskletT< Chunk >* pipeline = new PipelineTaskletT< Chunk >( true );
+ * pipeline->addStage( &reader );
+ * pipeline->addStage( &compressor, KoreEngine::Scheduler()->workerCount() );
+ * pipeline->addStage( &writer );
+ * KoreEngine::RunTasklet( pipeline, TaskletRunner::Asynchronous );
+ * @endcode
+ *
+ * The stages are not owned by the pipeline.
+ */
+template< typename T >
+class PipelineTaskletT : public PipelineTasklet
+{
+public:
+    PipelineTaskletT( kbool autoDelete = false );
+    virtual ~PipelineTaskletT();
+
+    /*!
+     * Append a stage, not while the pipeline is running.
+     * @param stage the stage.
+     * @param parallelism maximum number of workers running the stage at once.
+     * @param capacity capacity of the queue feeding the stage, not used for the
+     * first stage.
+     */
+    void addStage( const PipelineStage< T >* stage, kint parallelism = 1,
+                   kint capacity = DefaultCapacity );
+
+protected:
+    virtual Step step( kint stage );
+    virtual QString stageName( kint stage ) const;
+    virtual void clear();
+
+private:
+    QList< const PipelineStage< T >* >  _stages;
+    QList< BoundedQueue< T >* >         _queues;    //!< Input of the stage + 1
+};
+
+}}
+
+#include <src/parallel/PipelineTaskletT.cxx>
@@ -0,0 +1,202 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <KoreExport.hpp>
+
+#include <data/LibraryT.hpp>
+
+#include <parallel/Tasklet.hpp>
+
+#include <QtCore/QAtomicInt>
+
+namespace Kore { namespace parallel {
+
+/*!
+ * @class RangeTasklet
+ *
+ * @brief   A RangeTasklet applies the same operation to every index of a
+ *          range, spreading it over all the workers of the TaskletScheduler.
+ *
+ * The range is recursively split in halves: the running worker keeps one half
+ * and queues the other one, until the pieces are no bigger than the grain.
+ * Idle workers steal the biggest pending pieces, which saturates all the cores
+ * with a handful of queued tasks.
+ *
+ * The range may be the children of a Library, in which case it is sized from
+ * Library::size() when the tasklet is run. Unless specified, the grain is
+ * chosen so that every worker gets a few chunks to balance the load.
+ *
+ * The tasklet ends once every index has been processed, which happens on the
+ * workers even when it is run synchronously. Canceling it skips the indexes
+ * not processed yet.
+ *
+ * @sa Kore::parallel::RangeRunnerTasklet
+ * @sa Kore::parallel::RangeFunctorTasklet
+ */
+class KoreExport RangeTasklet : public Tasklet
+{
+    Q_OBJECT
+
+    class Chunk;
+
+protected:
+    /*!
+     * Constructor for the range [begin, end[.
+     * @param begin first index of the range.
+     * @param end index past the last one of the range.
+     * @param grain maximum number of indexes processed in a row by a worker,
+     * automatic if lower than 1.
+     * @param autoDelete if true, the Tasklet is automatically destroyed when completed.
+     * @return a RangeTasklet instance.
+     */
+    RangeTasklet( kint begin, kint end, kint grain = 0,
+                  kbool autoDelete = false );
+    /*!
+     * Constructor for the children of a library.
+     * @param target library whose children indexes make the range.
+     * @param grain maximum number of indexes processed in a row by a worker,
+     * automatic if lower than 1.
+     * @param autoDelete if true, the Tasklet is automatically destroyed when completed.
+     * @return a RangeTasklet instance.
+     */
+    RangeTasklet( Kore::data::Library* target, kint grain = 0,
+                  kbool autoDelete = false );
+
+public:
+    /*!
+     * @return the library whose children are processed, if any.
+     */
+    inline Kore::data::Library* target() const { return _target; }
+
+    /*!
+     * @return the grain, 0 if automatic.
+     */
+    inline kint grain() const { return _grain; }
+    /*!
+     * Set the grain. This has no effect on a running tasklet.
+     * @param grain maximum number of indexes processed in a row by a worker,
+     * automatic if lower than 1.
+     */
+    void grain( kint grain );
+
+    template< typename T, typename F >
+    static RangeTasklet* ForEach( Kore::data::LibraryT< T >* target,
+                                  F functor, kint grain = 0,
+                                  kbool autoDelete = false );
+    template< typename T, typename F >
+    static RangeTasklet* ForEach( Kore::data::Library* target,
+                                  F functor, kint grain = 0,
+                                  kbool autoDelete = false );
+
+protected:
+    /*!
+     * Process one index of the range.
+     *
+     * This is called concurrently from all the worker threads, it must be
+     * thread-safe.
+     * @param index the index to process.
+     */
+    virtual void runElement( kint index ) = K_NULL;
+
+    virtual QString runnerName() const;
+    virtual void run( Tasklet* tasklet ) const;
+
+private:
+    void split( kint begin, kint end );
+    void process( kint begin, kint end );
+
+private:
+    Kore::data::Library*    _target;
+    kint                    _begin;
+    kint                    _end;
+    kint                    _grain;
+
+    // Execution
+    kint                    _total;
+    kint                    _chunk;
+    QAtomicInt              _remaining; //!< Indexes not processed yet
+};
+
+/*!
+ * @class RangeRunnerTasklet
+ *
+ * A RangeTasklet running each Tasklet child of a Library on the worker
+ * threads, with the given TaskletRunner or with their own best runner.
+ */
+class KoreExport RangeRunnerTasklet : public RangeTasklet
+{
+    Q_OBJECT
+
+public:
+    /*!
+     * Constructor.
+     * @param target library of the tasklets to run.
+     * @param runner runner to use, the best runner of each tasklet if NULL.
+     * @param grain maximum number of tasklets run in a row by a worker,
+     * automatic if lower than 1.
+     * @param autoDelete if true, the Tasklet is automatically destroyed when completed.
+     * @return a RangeRunnerTasklet instance.
+     */
+    RangeRunnerTasklet( Kore::data::Library* target,
+                        const TaskletRunner* runner = K_NULL,
+                        kint grain = 0, kbool autoDelete = false );
+
+protected:
+    virtual void runElement( kint index );
+
+private:
+    const TaskletRunner* _runner;
+};
+
+/*!
+ * @class RangeFunctorTasklet
+ *
+ * A RangeTasklet calling a functor on each child of a Library, as a T*.
+ * The functor is shared by all the workers.
+ *
+ * @sa Kore::parallel::RangeTasklet::ForEach
+ */
+template< typename T, typename F >
+class RangeFunctorTasklet : public RangeTasklet
+{
+public:
+    RangeFunctorTasklet( Kore::data::Library* target, F functor,
+                         kint grain = 0, kbool autoDelete = false );
+
+protected:
+    virtual void runElement( kint index );
+
+private:
+    F _functor;
+};
+
+}}
+
+#include <src/parallel/RangeTasklet.cxx>
@@ -0,0 +1,141 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <KoreExport.hpp>
+
+#include <parallel/Tasklet.hpp>
+#include <parallel/TaskletObserver.hpp>
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+
+namespace Kore { namespace parallel {
+
+/*!
+ * @class TaskGraph
+ *
+ * @brief   A TaskGraph runs a set of Tasklet-s while honoring their
+ *          dependencies.
+ *
+ * A tasklet of the graph is queued on the TaskletScheduler as soon as all its
+ * predecessors completed. This happens right from the worker thread that
+ * completed the last of them: there is no round trip through the event loop
+ * between two stages of the graph.
+ *
+ * The graph itself is a Tasklet: it emits started when it is run, progress
+ * each time one of its tasklets ends and ended once they all did. It ends as
+ * Failed as soon as one of its tasklets did not complete, in which case the
+ * successors of that tasklet are not run and end as Canceled.
+ *
+ * The tasklets of a graph must not be auto-deleted, and the dependencies must
+ * not form a cycle.
+ *
+ * @sa Kore::parallel::Tasklet
+ */
+class KoreExport TaskGraph : public Tasklet, private TaskletObserver
+{
+    Q_OBJECT
+
+public:
+    /*!
+     * Constructor.
+     * @param autoDelete if true, the graph is destroyed when completed. This
+     * does not destroy the tasklets of the graph.
+     * @return a TaskGraph instance.
+     */
+    TaskGraph( kbool autoDelete = false );
+    virtual ~TaskGraph();
+
+    /*!
+     * Add a tasklet with no predecessor to the graph.
+     * @param tasklet the tasklet to add.
+     */
+    void addTasklet( Tasklet* tasklet );
+    /*!
+     * Add a tasklet to the graph, to be run once all its predecessors have
+     * completed. The predecessors are added to the graph as well.
+     * @param tasklet the tasklet to add.
+     * @param predecessors the tasklets that must complete first.
+     */
+    void addTasklet( Tasklet* tasklet, const QList< Tasklet* >& predecessors );
+    /*!
+     * Declare that successor must only run once predecessor has completed.
+     * Both tasklets are added to the graph if needed.
+     * @param predecessor the tasklet to complete first.
+     * @param successor the dependent tasklet.
+     */
+    void addDependency( Tasklet* predecessor, Tasklet* successor );
+
+    /*!
+     * @return the number of tasklets in the graph.
+     */
+    inline kint size() const { return _nodes.size(); }
+
+    /*!
+     * Remove all the tasklets from the graph (they are not destroyed).
+     */
+    void clear();
+
+public slots:
+    /*!
+     * Cancel the graph: the tasklets that are not started yet will not be,
+     * and the running ones are asked to cancel.
+     */
+    virtual void cancel();
+
+protected:
+    virtual QString runnerName() const;
+    virtual void run( Tasklet* tasklet ) const;
+
+private:
+    virtual void taskletEnded( Tasklet* tasklet, kint state );
+
+    struct Node;
+
+    kbool isAcyclic() const;
+    kbool aborted() const;
+    void execute();
+    void dispatch( Node* node );
+    void release( Node* node );
+    kbool settle( Node* node, kbool completed );
+    void finish();
+
+private:
+    QList< Node* >                  _nodes;
+    QHash< const Tasklet*, Node* >  _index;
+
+    QAtomicInt  _remaining; //!< Tasklets not ended yet
+    QAtomicInt  _ended;     //!< Tasklets ended (progress)
+    QAtomicInt  _failed;    //!< Tasklets that did not complete
+    QAtomicInt  _aborted;   //!< The graph was canceled
+};
+
+}}
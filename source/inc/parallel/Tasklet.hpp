@@ -32,12 +32,21 @@
 
 #include <data/Block.hpp>
 
+#include <parallel/CancellationToken.hpp>
 #include <parallel/TaskletRunner.hpp>
 
+#include <QtCore/QAtomicInt>
+#include <QtCore/QAtomicPointer>
+#include <QtCore/QByteArray>
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QEvent>
+#include <QtCore/QList>
 #include <QtCore/QMutex>
+#include <QtCore/QVariant>
 #include <QtCore/QWaitCondition>
 
+class QThread;
+
 namespace Kore {
 
 class KoreEngine;
@@ -45,6 +54,7 @@ class KoreEngine;
 namespace parallel {
 
 class MetaTasklet;
+class TaskletObserver;
 
 /*!
  * @class Tasklet
@@ -73,14 +83,18 @@ class KoreExport Tasklet
     Q_OBJECT
 
     friend class MetaTasklet;
+    friend class TaskGraph;
     friend class TaskletRunner;
+    friend class TaskletScheduler;
     friend class Kore::KoreEngine;
 
 protected:
     enum Flags
     {
         Cancellable =   Block::MAX_FLAG,
-        MAX_FLAG =      (Block::MAX_FLAG << 1)
+        Headless =      (Block::MAX_FLAG << 1),
+        Memoizable =    (Block::MAX_FLAG << 2),   //!< @see TaskletCache
+        MAX_FLAG =      (Block::MAX_FLAG << 3)
     };
 
 public:
@@ -117,11 +131,127 @@ protected:
 public:
     /*!
      * Wait for the completion of the tasklet.
+     *
+     * This does not lock anything if the tasklet is already finished.
+     *
      * @param timeout MAX number of ms to wait for completion before timeout. If set to ULONG_MAX, no timeout.
      * @return true if the task completed, false if the wait timed out.
      */
     kbool waitForFinished(kulong timeout = ULONG_MAX);
     kbool isRunning() const;
+    /*!
+     * Check whether the execution of the tasklet has ended (canceled, failed or completed).
+     *
+     * This is lock-free and can be polled from any thread. Once it returns true, the runner
+     * is entirely done with the tasklet: its observers were notified and it can be destroyed.
+     * The ended signal of a headless tasklet was emitted as well, that of any other tasklet
+     * is only posted to the event loop of its thread and may not be delivered yet.
+     *
+     * @return true if the tasklet is finished, false otherwise.
+     */
+    kbool isFinished() const;
+    /*!
+     * @return the current state of the tasklet, @see State
+     */
+    State state() const;
+
+    /*!
+     * Wait for the completion of all the given tasklets.
+     *
+     * This waits once, on a single counter shared by all the tasklets, rather
+     * than on each tasklet in turn.
+     *
+     * @param tasklets the tasklets to wait for.
+     * @param timeout MAX number of ms to wait for completion before timeout. If set to ULONG_MAX, no timeout.
+     * @return true if all the tasklets are finished, false if the wait timed out.
+     */
+    static kbool WaitForAll( const QList< Tasklet* >& tasklets,
+                             kulong timeout = ULONG_MAX );
+    /*!
+     * Wait for the completion of any of the given tasklets.
+     * @param tasklets the tasklets to wait for.
+     * @param timeout MAX number of ms to wait for completion before timeout. If set to ULONG_MAX, no timeout.
+     * @return the first tasklet found finished, NULL if the wait timed out.
+     */
+    static Tasklet* WaitForAny( const QList< Tasklet* >& tasklets,
+                                kulong timeout = ULONG_MAX );
+
+    /*!
+     * Register an observer, notified on the running thread each time the
+     * execution of the tasklet ends.
+     * @param observer the observer to register.
+     */
+    void addObserver( TaskletObserver* observer );
+    /*!
+     * Unregister an observer. Once this returns, the observer is guaranteed
+     * not to be notified anymore.
+     * @param observer the observer to unregister.
+     */
+    void removeObserver( TaskletObserver* observer );
+
+    /*!
+     * Hint about the size of the input of the tasklet, such as a number of
+     * elements or bytes. Execution times are profiled per order of magnitude
+     * of that hint to select the fastest runner, @see MetaTasklet::selectRunner
+     *
+     * This is called from the running thread.
+     *
+     * @return the input size hint, 0 by default.
+     */
+    virtual kuint64 sizeHint() const;
+
+    /*!
+     * Declare the data the tasklet works on, such as the ID of a Block or of
+     * the root of a Library subtree (@see Block::ID). The scheduler queues the
+     * tasklet on the worker that last ran a tasklet with the same key, where
+     * that data is likely still in the caches, unless that worker lags behind
+     * the others.
+     *
+     * This must be set before the tasklet is run.
+     * @param key the affinity key, 0 for none (the default).
+     */
+    void affinityKey( kid key );
+    /*!
+     * @return the affinity key, 0 if none.
+     */
+    kid affinityKey() const;
+
+    /*!
+     * Set whether the tasklet completes without any event loop.
+     *
+     * By default, the signals of the tasklet and its auto-deletion are
+     * delivered through the event loop of its thread. A headless tasklet
+     * emits them right from the thread that runs it instead, without any
+     * event dispatch: its thread does not need an event loop at all and an
+     * auto-deleting tasklet is destroyed by its runner. Progress is then
+     * coalesced by skipping the notifications while another thread is
+     * delivering one, the latest values are always delivered before it ends.
+     *
+     * Tasklets created without a QCoreApplication instance are headless.
+     * This must be set before the tasklet is run.
+     * @param headless true to complete without event loop.
+     */
+    void headless( kbool headless );
+    /*!
+     * @return true if the tasklet completes without event loop.
+     */
+    kbool isHeadless() const;
+
+    /*!
+     * Set the minimum interval between two progress signals.
+     *
+     * Progress reported by the runners is always coalesced: at most one progress
+     * notification per tasklet is pending at any time and only the latest values
+     * are delivered. With a non-zero interval, the signals are further throttled
+     * to at most one every msecs milliseconds.
+     *
+     * @param msecs the interval in milliseconds, 0 to only coalesce.
+     */
+    void progressInterval( kint msecs );
+    /*!
+     * @return the minimum interval between two progress signals in milliseconds.
+     */
+    kint progressInterval() const;
 
 protected:
     // This is always executed in the thread the Tasklet belongs to (the main thread).
@@ -129,12 +259,13 @@ protected:
      * Overloading Qt's custom event processing routine.
      *
      * This is required for proper multi-threading operations. Tasklets always belong in the main application's thread (in a Qt sense).
-     * Thus, when a TaskletRunner performs operations asynchronously on a Tasklet, it must send/post messages to it after acquiring its
-     * mutex.
+     * Thus, when a TaskletRunner performs operations asynchronously on a Tasklet, it must post messages to it. The state of the
+     * Tasklet itself is updated atomically by the runner, before the message is dispatched.
      *
      * @param e custom event to be processed
      */
     virtual void customEvent(QEvent* e);
+    virtual void timerEvent(QTimerEvent* e);
 
     /*!
      * Convenience method for TaskletRunner-s. This handles message dispatching for started signal.
@@ -153,6 +284,11 @@ protected:
      * Convenience method for TaskletRunner-s. This handles message dispatching for ended signal.
      */
     void runnerCompleted();
+    /*!
+     * Convenience method for TaskletRunner-s. This ends a Tasklet that was
+     * never started as canceled, without emitting the started signal.
+     */
+    void runnerSkipped();
 
     /*!
      * Convenience method for TaskletRunner-s. This allows runners to notify of progress.
@@ -171,11 +307,44 @@ protected:
      * Convenience method for TaskletRunner-s. Check if the computation should continue.
      *
      * TaskletRunner-s which implement the cancel operation should check regularly for the result of
-     * this method.
+     * this method. It also accounts for the cancellation token of the tasklet.
      *
      * @return true if the computation should continue, false otherwise.
      */
-    inline kbool keepRunning() { return _state == Running; }
+    inline kbool keepRunning()
+        { return _state == Running && ! _cancellationToken.isCanceled(); }
+
+    /*!
+     * Result of a Memoizable tasklet, cached once it completes. The result
+     * must only depend on the stored properties of the tasklet.
+     *
+     * This is called from the running thread.
+     *
+     * @return the result, an invalid one not to cache it (the default).
+     */
+    virtual QVariant memoizedResult() const;
+    /*!
+     * Restore the result of a Memoizable tasklet from the cache, instead of
+     * running it.
+     * @param result the result, as returned by memoizedResult().
+     */
+    virtual void memoizedResult( const QVariant& result );
+
+    /*!
+     * Copy of the tasklet for a hedged execution, @see MetaTasklet::hedgingPercentile
+     *
+     * The copy must have the same inputs and outputs of its own: two copies
+     * of a tasklet may run at once, while the tasklet itself is not run.
+     *
+     * @return a new copy, K_NULL not to hedge the tasklet (the default).
+     */
+    virtual Tasklet* hedgedCopy() const;
+    /*!
+     * Take over the result of the copy that completed first. This is called
+     * from the thread that ran it, before the tasklet ends.
+     * @param copy the copy, as returned by hedgedCopy().
+     */
+    virtual void hedgedResult( Tasklet* copy );
 
 signals:
     /*!
@@ -206,8 +375,11 @@ public slots:
      * This truly only makes sense for asynchronous execution of tasks.
      * This merely suggests that the execution of the tasklet should be canceled. There is
      * no guarantee that the running implementation is able to do so.
+     *
+     * The request outlives the execution, until the tasklet is run again: a periodic
+     * tasklet canceled between two of its runs is not run anymore.
      */
-    void cancel();
+    virtual void cancel();
     /*!
      * Check whether the tasklet can be cancelled.
      *
@@ -216,13 +388,69 @@ public slots:
     kbool isCancellable() const;
 
 public:
+    /*!
+     * Share a cancellation token with other tasklets. This must be set before
+     * the tasklet is run.
+     * @param token the token, an invalid one to detach the tasklet.
+     */
+    void cancellationToken( const CancellationToken& token );
+    /*!
+     * @return the cancellation token of the tasklet, invalid if none.
+     */
+    const CancellationToken& cancellationToken() const;
+    /*!
+     * Check whether the tasklet was asked to stop, either directly or through
+     * its cancellation token.
+     * @return true if the cancellation was requested, false otherwise.
+     */
+    kbool cancellationRequested() const;
+
     virtual const Kore::parallel::MetaTasklet* metaTasklet() const;
 
+private:
+    void rearm();
+    kbool runMemoized();
+    void runnerEnded( State state, kint eventType );
+    void endHeadless( State state );
+    void notifyProgress( kint kind );
+    void deliverProgress();
+
 private:
     kbool _autoDelete;
-    volatile State _state;
+    QAtomicInt _state;
+    QAtomicInt _cancelRequested;
+    // Periodic timers running the tasklet, they keep its cancellation request.
+    QAtomicInt _periodicTimers;
+    // The thread ending the tasklet, until it let go of it.
+    QAtomicPointer< QThread > _endingThread;
+    CancellationToken _cancellationToken;
+    QAtomicInt _waiters;
+    // Runner selected by the engine, to profile its execution time.
+    const TaskletRunner* _runner;
+    QElapsedTimer _runClock;
+    // Cache key of a Memoizable tasklet that missed the cache.
+    QByteArray _memoKey;
+    kid _affinityKey;
+    // Trace stamps in microseconds, -1 when not traced.
+    kint64 _traceSubmitted;
+    kint64 _traceStarted;
     QMutex _waitMutex;
     QWaitCondition _waitForFinished;
+    QMutex _observersMutex;
+    QList< TaskletObserver* > _observers;
+
+    // Latest progress, written by the runners, read by the main thread.
+    QAtomicInt _progressPending;
+    QAtomicInt _progressDelivering; //!< Headless only, one delivery at once
+    QAtomicInt _progressSequence;
+    volatile kuint64 _progress;
+    volatile kuint64 _progressTotal;
+    QMutex _progressMutex;
+    QString _progressMessage;
+    // Throttling, main thread only (delivering thread when headless).
+    kint _progressInterval;
+    kint _progressTimer;
+    QElapsedTimer _progressClock;
 };
 
 }}
@@ -0,0 +1,115 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <KoreExport.hpp>
+#include <Types.hpp>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QVariant>
+
+namespace Kore {
+
+class KoreEngine;
+
+namespace parallel {
+
+class Tasklet;
+
+/*!
+ * @class TaskletCache
+ *
+ * @brief   Memoizes the results of the deterministic tasklets.
+ *
+ * A tasklet whose result only depends on its stored properties may opt in by
+ * setting its Memoizable flag and implementing Tasklet::memoizedResult. When it
+ * is run, the tasklet is looked up by its type and the values of its stored
+ * properties (identified by the same MetaBlock property hashes as the KoreV1
+ * serialization format): on a hit, its result is restored and it completes
+ * right away without any runner, on a miss its result is cached once it
+ * completes.
+ *
+ * Pointer properties would be keyed by address, whatever they point to: a
+ * Memoizable tasklet must not have any stored pointer property, it is never
+ * memoized otherwise.
+ *
+ * The cache holds a bounded number of results and evicts the least recently
+ * used ones first.
+ */
+class KoreExport TaskletCache
+{
+    friend class Tasklet;
+    friend class Kore::KoreEngine;
+
+public:
+    /*!
+     * Cache usage statistics.
+     */
+    struct Statistics
+    {
+        kuint64 hits;       //!< Lookups that found a result
+        kuint64 misses;     //!< Lookups that did not
+        kint    entries;    //!< Number of results held
+        kint    capacity;   //!< Maximum number of results held
+        kdouble hitRate;    //!< Ratio of the lookups that found a result
+    };
+
+    static const kint DefaultCapacity = 1024;
+
+public:
+    /*!
+     * Set the maximum number of results held, the least recently used ones
+     * are evicted right away if needed.
+     * @param capacity maximum number of results, 0 disables the cache.
+     */
+    static void Capacity( kint capacity );
+    /*!
+     * @return the maximum number of results held.
+     */
+    static kint Capacity();
+
+    /*!
+     * @return the usage statistics of the cache.
+     */
+    static Statistics Stats();
+
+    /*!
+     * Drop all the results, the statistics are kept.
+     */
+    static void Clear();
+
+private:
+    TaskletCache();
+
+    static QByteArray Key( const Tasklet* tasklet );
+    static kbool Lookup( const QByteArray& key, QVariant* result );
+    static void Insert( const QByteArray& key, const QVariant& result );
+};
+
+}}
@@ -0,0 +1,180 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <KoreExport.hpp>
+#include <Types.hpp>
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+
+class QThread;
+
+namespace Kore { namespace parallel {
+
+/*!
+ * @class TaskletFuture
+ *
+ * @brief   Handle on the eventual outcome of a Tasklet.
+ *
+ * A future is finished once the tasklet it was created for ended, its state
+ * then is the final state of the tasklet (@see Tasklet::State). Futures are
+ * cheap to copy, all the copies share the same state.
+ *
+ * This is the untyped part of the futures, use TaskletFutureT to access the
+ * value produced by the tasklet or to chain continuations.
+ *
+ * @sa Kore::parallel::TaskletFutureT
+ */
+class KoreExport TaskletFuture
+{
+public:
+    class SharedState;
+
+    /*!
+     * A piece of work to be run once a future is finished.
+     */
+    class KoreExport Continuation
+    {
+    public:
+        /*!
+         * Constructor.
+         * @param thread the thread to run on, K_NULL to run on the thread
+         *        finishing the future.
+         */
+        Continuation( QThread* thread = K_NULL );
+        virtual ~Continuation();
+
+        /*!
+         * @return the thread to run on, K_NULL for any.
+         */
+        inline QThread* thread() const { return _thread; }
+
+        /*!
+         * Run the continuation.
+         * @param state the finished state of the future.
+         */
+        virtual void run( SharedState* state ) = K_NULL;
+
+    private:
+        QThread* _thread;
+    };
+
+    /*!
+     * The state shared by all the copies of a future.
+     */
+    class KoreExport SharedState
+    {
+    public:
+        SharedState();
+        virtual ~SharedState();
+
+        void ref();
+        void deref();
+
+        inline kint state() const { return _state; }
+        kbool isFinished() const;
+        kbool wait( kulong timeout );
+
+        /*!
+         * Finish the future, the value (if any) must be set already. This runs
+         * or dispatches the continuations.
+         * @param state the final state, @see Tasklet::State
+         */
+        void finish( kint state );
+        /*!
+         * Add a continuation, taking ownership of it. It is run right away if
+         * the future is finished already.
+         * @param continuation the continuation.
+         */
+        void addContinuation( Continuation* continuation );
+
+    private:
+        void run( Continuation* continuation );
+
+    private:
+        QAtomicInt              _refs;
+        QAtomicInt              _state;
+        QAtomicInt              _waiters;
+        QMutex                  _mutex;
+        QWaitCondition          _condition;
+        QList< Continuation* >  _continuations;
+    };
+
+public:
+    /*!
+     * Constructor of an invalid future.
+     */
+    TaskletFuture();
+    TaskletFuture( const TaskletFuture& other );
+    virtual ~TaskletFuture();
+
+    TaskletFuture& operator=( const TaskletFuture& other );
+
+    /*!
+     * @return true if the future is bound to a tasklet, false otherwise.
+     */
+    kbool isValid() const;
+    /*!
+     * Lock-free check of the end of the tasklet.
+     * @return true if the future is finished, false otherwise.
+     */
+    kbool isFinished() const;
+    /*!
+     * @return true if the tasklet completed and the value is available.
+     */
+    kbool isCompleted() const;
+    /*!
+     * @return the state of the future, @see Tasklet::State
+     */
+    kint state() const;
+
+    /*!
+     * Wait for the future to be finished.
+     * @param timeout MAX number of ms to wait. If set to ULONG_MAX, no timeout.
+     * @return true if the future is finished, false if the wait timed out.
+     */
+    kbool waitForFinished( kulong timeout = ULONG_MAX ) const;
+
+protected:
+    /*!
+     * Constructor, adopting the given state.
+     * @param state the shared state.
+     */
+    TaskletFuture( SharedState* state );
+
+    inline SharedState* sharedState() const { return _state; }
+
+private:
+    SharedState* _state;
+};
+
+}}
@@ -0,0 +1,188 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <parallel/Tasklet.hpp>
+#include <parallel/TaskletFuture.hpp>
+#include <parallel/TaskletObserver.hpp>
+
+namespace Kore { namespace parallel {
+
+/*!
+ * @class TaskletFutureT
+ *
+ * @brief   Typed future, giving access to the value produced by a Tasklet.
+ *
+ * The value is read from the tasklet on the thread that ran it, right when
+ * it completes. Continuations registered with then() run on that same thread
+ * (or on the given thread, through its event loop) and produce futures of
+ * their own, so that whole chains of computations never go through the main
+ * event loop:
+ *
+ * @code
+ * TaskletFutureT< QImage > image = TaskletFutureT< QImage >::Of( decoder );
+ * TaskletFutureT< QImage > thumbnail = image.then< QImage >( Scaler( 64 ) );
+ * thumbnail.then( &Display, QCoreApplication::instance()->thread() );
+ * KoreEngine::RunTasklet( decoder, TaskletRunner::Asynchronous );
+ * @endcode
+ *
+ * If the tasklet (or a continuation's source) does not complete, the value is
+ * not produced and the continuations only propagate the final state. A future
+ * whose tasklet is destroyed before it ended finishes as canceled.
+ *
+ * Continuations returning void produce a TaskletFutureT< void >, which only
+ * tells when they are done. Its own continuations take no argument.
+ *
+ * @sa Kore::parallel::TaskletFuture
+ */
+template< typename T >
+class TaskletFutureT : public TaskletFuture
+{
+    template< typename U > friend class TaskletFutureT;
+
+public:
+    /*!
+     * Constructor of an invalid future.
+     */
+    TaskletFutureT();
+
+    /*!
+     * Create the future of a tasklet, which must provide a T result() const
+     * method. The future has to be created before the tasklet is run.
+     * @param tasklet the tasklet.
+     * @return the future of the tasklet.
+     */
+    template< class C >
+    static TaskletFutureT< T > Of( C* tasklet );
+    /*!
+     * Create the future of a tasklet. The future has to be created before
+     * the tasklet is run.
+     * @param tasklet the tasklet.
+     * @param getter the method of the tasklet returning its result.
+     * @return the future of the tasklet.
+     */
+    template< class C >
+    static TaskletFutureT< T > Of( C* tasklet, T ( C::*getter )() const );
+
+    /*!
+     * Wait for the future to be finished and get its value.
+     * @return the value, a default constructed one if it did not complete.
+     */
+    T result() const;
+
+    /*!
+     * Chain a continuation, called with the value once it is available.
+     * @param continuation the function to call.
+     * @param thread the thread to call it on, K_NULL for the thread that
+     *        finishes the future.
+     * @return the future of the value returned by the continuation.
+     */
+    template< typename R >
+    TaskletFutureT< R > then( R ( *continuation )( const T& ),
+                              QThread* thread = K_NULL ) const;
+    /*!
+     * Chain a continuation functor, called with the value once it is
+     * available.
+     * @param continuation the functor to call.
+     * @param thread the thread to call it on, K_NULL for the thread that
+     *        finishes the future.
+     * @return the future of the value returned by the continuation.
+     */
+    template< typename R, typename F >
+    TaskletFutureT< R > then( F continuation, QThread* thread = K_NULL ) const;
+
+private:
+    class ValueState;
+    template< class C > class Watcher;
+    template< typename R, typename F > class Then;
+
+    TaskletFutureT( ValueState* state );
+
+    inline ValueState* valueState() const
+        { return static_cast< ValueState* >( sharedState() ); }
+};
+
+/*!
+ * Future of a tasklet, or of a continuation, that produces no value.
+ */
+template<>
+class TaskletFutureT< void > : public TaskletFuture
+{
+    template< typename U > friend class TaskletFutureT;
+
+public:
+    /*!
+     * Constructor of an invalid future.
+     */
+    TaskletFutureT();
+
+    /*!
+     * Create the future of a tasklet. The future has to be created before
+     * the tasklet is run.
+     * @param tasklet the tasklet.
+     * @return the future of the tasklet.
+     */
+    static TaskletFutureT< void > Of( Tasklet* tasklet );
+
+    /*!
+     * Wait for the future to be finished.
+     */
+    void result() const;
+
+    /*!
+     * Chain a continuation, called once the future completed.
+     * @param continuation the function to call.
+     * @param thread the thread to call it on, K_NULL for the thread that
+     *        finishes the future.
+     * @return the future of the value returned by the continuation.
+     */
+    template< typename R >
+    TaskletFutureT< R > then( R ( *continuation )(),
+                              QThread* thread = K_NULL ) const;
+    /*!
+     * Chain a continuation functor, called once the future completed.
+     * @param continuation the functor to call.
+     * @param thread the thread to call it on, K_NULL for the thread that
+     *        finishes the future.
+     * @return the future of the value returned by the continuation.
+     */
+    template< typename R, typename F >
+    TaskletFutureT< R > then( F continuation, QThread* thread = K_NULL ) const;
+
+private:
+    class ValueState;
+    class Watcher;
+    template< typename R, typename F > class Then;
+
+    TaskletFutureT( ValueState* state );
+};
+
+}}
+
+#include <src/parallel/TaskletFutureT.cxx>
@@ -0,0 +1,76 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <KoreExport.hpp>
+#include <Types.hpp>
+
+namespace Kore { namespace parallel {
+
+class Tasklet;
+
+/*!
+ * @class TaskletObserver
+ *
+ * A TaskletObserver is notified of the end of the execution of the Tasklet-s
+ * it observes, on the thread that ran them.
+ *
+ * Contrary to the Tasklet::ended signal, which is delivered through the event
+ * loop of the Tasklet's thread, this allows to chain further work right from
+ * the worker threads.
+ *
+ * @sa Kore::parallel::Tasklet::addObserver
+ */
+class KoreExport TaskletObserver
+{
+public:
+    virtual ~TaskletObserver();
+
+    /*!
+     * Called when a TaskletRunner ended the execution of the tasklet.
+     *
+     * This is called on the thread that ran the tasklet, before the ended
+     * signal is emitted. Implementations must be thread-safe and should not
+     * block. They may unregister themselves from the tasklet.
+     *
+     * @param tasklet the tasklet that ended.
+     * @param state state at the end, @see Tasklet::State
+     */
+    virtual void taskletEnded( Tasklet* tasklet, kint state ) = K_NULL;
+    /*!
+     * Called when the tasklet is destroyed while still observed, typically
+     * because it never ended. The tasklet is half destroyed already: only its
+     * address is meaningful. Does nothing by default.
+     *
+     * @param tasklet the tasklet being destroyed.
+     */
+    virtual void taskletDestroyed( Tasklet* tasklet );
+};
+
+}}
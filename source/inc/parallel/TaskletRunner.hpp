@@ -32,8 +32,11 @@
 
 #include <data/Block.hpp>
 
+#include <QtCore/QList>
+
 namespace Kore { namespace parallel {
 
+class Job;
 class Tasklet;
 
 /*!
@@ -50,6 +53,18 @@ public:
 		Asynchronous,
 	};
 
+	/*!
+	 * Priority of an asynchronous execution. Higher priorities always run first.
+	 */
+	enum Priority
+	{
+		LowPriority,		//!< Background work (saving, indexing...)
+		NormalPriority,
+		HighPriority,
+		CriticalPriority,	//!< Interactive work
+		InheritPriority		//!< Priority of the running task, normal otherwise
+	};
+
 public:
 	virtual ~TaskletRunner();
 
@@ -65,6 +80,16 @@ public:
 	 */
 	virtual kint performanceScore() const = K_NULL;
 
+	/*!
+	 * Instruction set extensions this implementation is compiled for.
+	 *
+	 * A runner requiring features the host CPU lacks is not registered, so that plugins may ship
+	 * several builds of the same operations and let each host use the fastest one it supports.
+	 *
+	 * @return combination of Kore::system::CPU::Feature flags, none by default.
+	 */
+	virtual kuint requiredFeatures() const;
+
 	/*!
 	 * This method implements the actual operations on the Tasklet.
 	 *
@@ -75,6 +100,34 @@ public:
 	 */
 	virtual void run(Tasklet* tasklet) const = K_NULL;
 
+	/*!
+	 * Maximum number of tasklets this implementation processes at once in runBatch().
+	 *
+	 * Implementations able to process several tasklets of the same type together (such as a
+	 * single SIMD pass over all their data) return more than 1: the asynchronous executions are
+	 * then fused into batches, @see MetaTasklet::batching
+	 *
+	 * @return maximum batch size, 1 by default (no batches).
+	 */
+	virtual kint maxBatchSize() const;
+
+	/*!
+	 * This method implements the operations on a batch of tasklets of the same type, each of
+	 * them being started and ended on its own as with run(). The default implementation runs
+	 * them one after the other.
+	 *
+	 * @param tasklets The tasklets to run, at most maxBatchSize() of them.
+	 */
+	virtual void runBatch(const QList<Tasklet*>& tasklets) const;
+
+	/*!
+	 * This method implements the operations on a lightweight Job whose meta tasklet is the one of this
+	 * runner. The default implementation runs the job's own implementation.
+	 *
+	 * @param job The job to run.
+	 */
+	virtual void runJob(Job* job) const;
+
 protected:
 	void start(Tasklet* tasklet) const;
 	void cancel(Tasklet* tasklet) const;
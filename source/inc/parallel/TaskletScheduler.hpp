@@ -0,0 +1,534 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <KoreExport.hpp>
+
+#include <data/Block.hpp>
+
+#include <parallel/TaskletRunner.hpp>
+#include <parallel/TimerWheel.hpp>
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QVector>
+#include <QtCore/QWaitCondition>
+
+class QRunnable;
+
+namespace Kore {
+
+class KoreEngine;
+
+namespace parallel {
+
+class Job;
+class MetaTasklet;
+class Tasklet;
+
+/*!
+ * @class TaskletScheduler
+ *
+ * @brief   Work-stealing thread pool running the asynchronous tasklets.
+ *
+ * Every worker thread owns two queues: a deque for the tasks scheduled from
+ * the worker itself (popped LIFO by its owner, to keep the data hot in its
+ * cache) and an inbox for the tasks scheduled from any other thread (spread
+ * round-robin over the workers and popped FIFO). A worker running out of
+ * tasks steals from the oldest end of the other workers queues before going
+ * to sleep.
+ *
+ * A tasklet declaring an affinity key is queued on the inbox of the worker
+ * that last ran that key instead, as long as that worker does not lag behind
+ * the others. The keys are hashed in a fixed table, colliding keys only share
+ * their preferred worker.
+ *
+ * Every queue is split by priority: a worker always runs the highest priority
+ * task it can find, and within a priority the tasks with the closest deadline
+ * (kept in a shared queue ordered by deadline) before the others.
+ *
+ * The scheduler is owned by the KoreEngine and its threads are started on the
+ * first asynchronous submission. Unless specified otherwise, there is one
+ * worker per logical processor.
+ *
+ * @sa Kore::KoreEngine::RunTasklet
+ * @sa Kore::KoreEngine::Scheduler
+ */
+class KoreExport TaskletScheduler : public Kore::data::Block
+{
+    friend class Kore::KoreEngine;
+
+private:
+    struct Task
+    {
+        Tasklet*                tasklet;
+        const TaskletRunner*    runner;
+        QRunnable*              runnable;   //!< Instead of a tasklet
+        Job*                    job;        //!< Instead of a tasklet
+        kint                    priority;
+        kint64                  deadline;   //!< In us, NoDeadline if none
+        kint64                  submitted;  //!< In us, 0 until queued
+        const MetaTasklet*      metaTasklet; //!< Of the tasklets of a runnable
+    };
+
+    class TaskDeque;
+    class Worker;
+    struct LaterDeadline;
+    struct DelayedTask;
+    struct FiredTimer;
+    class TimerThread;
+    struct Hedge;
+    class HedgeTask;
+    struct Batch;
+    class BatchTask;
+
+    static const kint PriorityCount = TaskletRunner::InheritPriority;
+    static const kint AffinitySlots = 1024;     // Has to be a power of 2 !
+    static const kint AffinityImbalance = 4;    //!< Tasks over the average
+
+    enum SchedulerState
+    {
+        NotStarted = 0x0,
+        Started,
+        Stopped
+    };
+
+    enum Admission
+    {
+        Admitted,
+        Rejected,
+        RunHere
+    };
+
+protected:
+    /*!
+     * Constructor.
+     * @return a TaskletScheduler instance.
+     */
+    TaskletScheduler();
+
+public:
+    /*!
+     * Queuing latency statistics of a priority level, from the submission of
+     * the tasks to the start of their execution.
+     */
+    struct LatencyStats
+    {
+        kuint64 count;              //!< Number of tasks started
+        kuint64 averageLatency;     //!< Average latency in us
+        kuint64 maxLatency;         //!< Maximum latency in us
+        kuint64 missedDeadlines;    //!< Tasks started past their deadline
+    };
+
+    /*!
+     * What a submission does when the queues are full, @see queueCapacity
+     */
+    enum QueuePolicy
+    {
+        BlockSubmitter,     //!< Wait for room in the queues
+        RejectSubmission,   //!< Do not run it, the submission returns false
+        RunOnCaller         //!< Run it synchronously on the submitting thread
+    };
+
+public:
+    virtual ~TaskletScheduler();
+
+    /*!
+     * Queue the tasklet for execution by the given runner on a worker thread.
+     *
+     * Once the scheduler has been stopped, the tasklet is run synchronously.
+     * @param tasklet the tasklet to run.
+     * @param runner the runner to use.
+     * @param priority the priority of the execution.
+     * @param deadline the deadline in ms from now, no deadline if negative.
+     * @return false if the tasklet was rejected, @see queuePolicy
+     */
+    kbool schedule( Tasklet* tasklet, const TaskletRunner* runner,
+                   TaskletRunner::Priority priority
+                        = TaskletRunner::InheritPriority,
+                   kint deadline = -1 );
+    /*!
+     * Queue a tasklet that carries on work already admitted, such as the
+     * nodes of a TaskGraph released by their predecessors. It is neither
+     * subject to the queue capacity nor run on the submitting thread, a
+     * rejection would leave that work unfinished.
+     *
+     * Once the scheduler has been stopped, the tasklet is run synchronously.
+     * @param tasklet the tasklet to run.
+     * @param runner the runner to use.
+     * @param priority the priority of the execution.
+     */
+    void scheduleContinuation( Tasklet* tasklet, const TaskletRunner* runner,
+                               TaskletRunner::Priority priority
+                                    = TaskletRunner::InheritPriority );
+    /*!
+     * Queue a runnable for execution on a worker thread. This is meant for
+     * the internal pieces of work of the parallel engine (such as the chunks
+     * of a RangeTasklet) that do not deserve a Tasklet of their own.
+     *
+     * The runnable is deleted once run if it is auto-deleting. Once the
+     * scheduler has been stopped, the runnable is run synchronously.
+     * @param runnable the runnable to run.
+     * @param priority the priority of the execution.
+     * @param deadline the deadline in ms from now, no deadline if negative.
+     */
+    void schedule( QRunnable* runnable,
+                   TaskletRunner::Priority priority
+                        = TaskletRunner::InheritPriority,
+                   kint deadline = -1 );
+    /*!
+     * Queue a lightweight job for execution by the given runner on a worker
+     * thread. The job is destroyed once run, a rejected job is destroyed
+     * without being run and its counter released.
+     *
+     * Once the scheduler has been stopped, the job is run synchronously.
+     * @param job the job to run.
+     * @param runner the runner to use, K_NULL for the job's own implementation.
+     * @param priority the priority of the execution.
+     * @param deadline the deadline in ms from now, no deadline if negative.
+     * @return false if the job was rejected, @see queuePolicy
+     */
+    kbool schedule( Job* job, const TaskletRunner* runner,
+                   TaskletRunner::Priority priority
+                        = TaskletRunner::InheritPriority,
+                   kint deadline = -1 );
+    /*!
+     * Queue a batch of tasklets at once: the queues are locked once per
+     * worker and at most one worker per tasklet is woken up. The batch is
+     * admitted as a whole by the queue capacity, it only has to fit in empty
+     * queues.
+     *
+     * Once the scheduler has been stopped, the tasklets are run synchronously.
+     * @param tasklets the tasklets to run.
+     * @param runners the runner to use for each tasklet.
+     * @param priority the priority of the executions.
+     * @param deadline the deadline in ms from now, no deadline if negative.
+     * @return false if the tasklets were rejected, @see queuePolicy
+     */
+    kbool schedule( const QList< Tasklet* >& tasklets,
+                   const QList< const TaskletRunner* >& runners,
+                   TaskletRunner::Priority priority
+                        = TaskletRunner::InheritPriority,
+                   kint deadline = -1 );
+
+    /*!
+     * Run a tasklet through copies of it, hedging the given runner with a
+     * second one: if the copy run by the first runner is not finished once
+     * the delay elapsed, another copy is run by the second runner. The first
+     * copy to complete wins, the other one is canceled.
+     *
+     * The tasklet is not run itself, it is started with the first copy and
+     * ends with the winning one (@see Tasklet::hedgedCopy). It is run as
+     * usual by the first runner if it can not be copied.
+     * @param tasklet the tasklet to run.
+     * @param runner the runner to use.
+     * @param hedgingRunner the runner to use past the delay.
+     * @param delay the delay in ms.
+     * @param priority the priority of the executions.
+     * @param deadline the deadline in ms from now, no deadline if negative.
+     * @return false if the tasklet was rejected, @see queuePolicy
+     */
+    kbool scheduleHedged( Tasklet* tasklet, const TaskletRunner* runner,
+                         const TaskletRunner* hedgingRunner, kint delay,
+                         TaskletRunner::Priority priority
+                            = TaskletRunner::InheritPriority,
+                         kint deadline = -1 );
+
+    /*!
+     * Queue a batch of tasklets of the same type, run at once on a worker
+     * thread by the given runner, @see TaskletRunner::runBatch
+     *
+     * The batch is a single task, exempt from the queue capacity. Once the
+     * scheduler has been stopped, the batch is run synchronously.
+     * @param tasklets the tasklets to run, at most runner->maxBatchSize().
+     * @param runner the runner to use.
+     * @param priority the priority of the execution.
+     */
+    void scheduleBatch( const QList< Tasklet* >& tasklets,
+                        const TaskletRunner* runner,
+                        TaskletRunner::Priority priority
+                            = TaskletRunner::InheritPriority );
+    /*!
+     * Queue a tasklet in the pending batch of its runner. The batch is
+     * dispatched once it holds the given number of tasklets, or once the
+     * window elapsed since its first tasklet joined.
+     *
+     * A batch runs with the highest priority of its tasklets. The tasklet is
+     * queued on its own if the batch can not wait.
+     * @param tasklet the tasklet to run.
+     * @param runner the runner to use.
+     * @param size the maximum size of the batch.
+     * @param window the maximum time in ms the batch waits to fill.
+     * @param priority the priority of the execution.
+     * @return false if the tasklet was rejected, @see queuePolicy
+     */
+    kbool scheduleBatched( Tasklet* tasklet, const TaskletRunner* runner,
+                           kint size, kint window,
+                           TaskletRunner::Priority priority
+                                = TaskletRunner::InheritPriority );
+
+    /*!
+     * Run a tasklet asynchronously once the given delay has elapsed.
+     *
+     * The delays are kept in a hierarchical timer wheel with a millisecond
+     * resolution, served by a single timer thread: any number of timers can
+     * be pending at a constant cost each.
+     * @param tasklet the tasklet to run, through the runner of its choice.
+     * @param delay the delay in ms.
+     * @param priority the priority of the execution.
+     * @return the id of the timer, @see cancelTimer
+     */
+    kint scheduleAfter( Tasklet* tasklet, kint delay,
+                        TaskletRunner::Priority priority
+                            = TaskletRunner::NormalPriority );
+    /*!
+     * Run a tasklet asynchronously at a fixed rate, the same tasklet being run
+     * again and again. An occurrence is skipped while the previous run is not
+     * over.
+     *
+     * The timer is canceled with cancelTimer() or once the cancellation of the
+     * tasklet is requested, in which case it ends canceled. The tasklet must
+     * not be auto-deleting, nor be destroyed before its timer is canceled.
+     * @param tasklet the tasklet to run, through the runner of its choice.
+     * @param period the period in ms.
+     * @param delay the delay in ms before the first run, the period if negative.
+     * @param priority the priority of the executions.
+     * @return the id of the timer, @see cancelTimer
+     */
+    kint scheduleEvery( Tasklet* tasklet, kint period, kint delay = -1,
+                        TaskletRunner::Priority priority
+                            = TaskletRunner::NormalPriority );
+    /*!
+     * Cancel a timer. Once this returns, the tasklet is guaranteed not to be
+     * submitted by the timer anymore.
+     * @param timer the id of the timer.
+     * @return true if the timer was pending, false otherwise.
+     */
+    kbool cancelTimer( kint timer );
+    /*!
+     * @return the number of pending timers.
+     */
+    kint timerCount() const;
+
+    /*!
+     * @return the number of worker threads.
+     */
+    kint workerCount() const;
+    /*!
+     * Set the number of worker threads. This has no effect once the workers
+     * have been started.
+     * @param count number of workers, the CPUs count is used if lower than 1.
+     */
+    void workerCount( kint count );
+    /*!
+     * @return the index of the calling worker thread, -1 if the caller is not
+     * one of the workers.
+     */
+    kint workerIndex() const;
+
+    /*!
+     * Bound the number of queued tasks, so that submitters outrunning the
+     * workers do not grow the queues without limit. Only the submissions of
+     * tasklets and jobs are bound, the internal runnables are not.
+     *
+     * The bound is approximate: concurrent submitters may each exceed it by
+     * the size of their submission.
+     * @param capacity the maximum number of queued tasks, 0 for no limit.
+     */
+    void queueCapacity( kint capacity );
+    /*!
+     * @return the maximum number of queued tasks, 0 if there is no limit.
+     */
+    kint queueCapacity() const;
+    /*!
+     * Set what the submissions do when the queues are full. The workers never
+     * wait for room, they run their submissions themselves instead.
+     * @param policy the policy, BlockSubmitter by default.
+     */
+    void queuePolicy( QueuePolicy policy );
+    /*!
+     * @return the policy applied when the queues are full.
+     */
+    QueuePolicy queuePolicy() const;
+    /*!
+     * @return the number of submissions that found the queues full so far.
+     */
+    kuint64 queueFullCount() const;
+    /*!
+     * @return the number of submissions rejected so far.
+     */
+    kuint64 rejectedCount() const;
+
+    /*!
+     * @return the number of tasks run by the worker that last ran their
+     * affinity key so far, @see Tasklet::affinityKey
+     */
+    kuint64 affinityCount() const;
+
+    /*!
+     * @return the number of tasklets set aside over the concurrency limit of
+     * their type, @see MetaTasklet::maxConcurrency
+     */
+    kint parkedCount() const;
+
+    /*!
+     * @return the number of tasks queued and not yet picked by a worker.
+     */
+    kint queueDepth() const;
+    /*!
+     * @param worker index of the worker.
+     * @return the number of tasks queued on the given worker.
+     */
+    kint queueDepth( kint worker ) const;
+
+    /*!
+     * @return the number of tasks stolen by the workers so far.
+     */
+    kuint64 stealCount() const;
+    /*!
+     * @param worker index of the worker.
+     * @return the number of tasks stolen by the given worker so far.
+     */
+    kuint64 stealCount( kint worker ) const;
+
+    /*!
+     * @param worker index of the worker.
+     * @return the number of tasks executed by the given worker so far.
+     */
+    kuint64 executedCount( kint worker ) const;
+
+    /*!
+     * Get the queuing latency statistics of a priority level. These are
+     * approximate while the workers are running.
+     * @param priority the priority level.
+     * @return the latency statistics.
+     */
+    LatencyStats latencyStats( TaskletRunner::Priority priority ) const;
+
+protected:
+    virtual void library( Kore::data::Library* lib );
+
+private:
+    void start();
+    void stop();
+
+    kint addTimer( Tasklet* tasklet, kint delay, kint period,
+                   TaskletRunner::Priority priority, Hedge* hedge = K_NULL );
+    kint addTimer( DelayedTask* task, kint delay );
+    void runTimers();
+    void fire( DelayedTask* task, kuint64 now, QList< FiredTimer >& fired );
+    void deleteTimer( DelayedTask* task );
+    void submit( const FiredTimer& fired );
+
+    void schedule( QRunnable* runnable, const MetaTasklet* metaTasklet,
+                   TaskletRunner::Priority priority, kint deadline );
+    void launchHedge( Hedge* hedge );
+    void runHedge( Hedge* hedge, kint index );
+    void releaseHedge( Hedge* hedge );
+
+    void flushBatch( Batch* batch, kint generation );
+    void runBatch( const TaskletRunner* runner,
+                   const QList< Tasklet* >& tasklets );
+
+    Worker* currentWorker() const;
+    Worker* affineWorker( const Task& task ) const;
+    Admission admit( kint count );
+    kbool submit( Task& task, Admission admission,
+                  TaskletRunner::Priority priority, kint deadline );
+    void runHere( Task& task, TaskletRunner::Priority priority,
+                  kint deadline );
+    void prepare( Task& task, TaskletRunner::Priority priority,
+                  kint deadline, const Worker* worker ) const;
+    void push( Worker* target, const Task& task, const Worker* worker );
+    void enqueue( Task& task, TaskletRunner::Priority priority,
+                  kint deadline );
+    void enqueue( QVector< Task >& tasks, TaskletRunner::Priority priority,
+                  kint deadline );
+    void wake( kint count );
+    void execute( const Task& task );
+
+    void work( Worker* worker );
+    static const MetaTasklet* MetaTaskletOf( const Task& task );
+    kbool startRun( const MetaTasklet* metaTasklet, const Task& task );
+    void endRun( const MetaTasklet* metaTasklet );
+    kbool nextTask( Worker* worker, Task* task );
+    kbool nextTask( Worker* worker, kint priority, Task* task );
+
+private:
+    QList< Worker* >    _workers;
+    kint                _workerCount;
+
+    QMutex              _stateMutex;
+    QAtomicInt          _state;
+
+    QAtomicInt          _pending;       //!< Tasks queued, not yet picked
+    QAtomicInt          _levelPending[ PriorityCount ];
+    QAtomicInt          _sleeping;      //!< Workers waiting for tasks
+    QAtomicInt          _nextWorker;    //!< Round-robin for external tasks
+    QAtomicInt          _affinity[ AffinitySlots ]; //!< Last worker + 1 per key
+
+    QMutex              _idleMutex;
+    QWaitCondition      _idleCondition;
+
+    kint                _queueCapacity;
+    kint                _queuePolicy;
+    mutable QMutex      _capacityMutex;
+    QWaitCondition      _capacityCondition;
+    QAtomicInt          _capacityWaiters;   //!< Submitters waiting for room
+    kuint64             _queueFullCount;
+    kuint64             _rejectedCount;
+
+    mutable QMutex      _parkedMutex;
+    QHash< const MetaTasklet*, QList< Task > > _parked; //!< Over their limit
+
+    QMutex              _deadlinesMutex;
+    QVector< Task >     _deadlines[ PriorityCount ];   //!< Binary heaps
+    QAtomicInt          _deadlinesPending[ PriorityCount ];
+
+    mutable QMutex      _timersMutex;
+    QWaitCondition      _timersCondition;
+    TimerWheel          _timers;        //!< In ms of the clock
+    QHash< kint, DelayedTask* > _delayed;
+    QList< kint >       _firing;        //!< Periodic timers being submitted
+    QWaitCondition      _firedCondition;
+    kint                _nextTimer;
+    TimerThread*        _timerThread;
+    kbool               _timersStopped;
+
+    QMutex              _batchesMutex;
+    QHash< const TaskletRunner*, Batch* > _batches;    //!< Per runner
+    kbool               _batchesStopped;
+
+    QElapsedTimer       _clock;
+};
+
+}}
@@ -0,0 +1,97 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <KoreExport.hpp>
+#include <Types.hpp>
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QString>
+
+namespace Kore {
+
+class KoreEngine;
+
+namespace parallel {
+
+class Tasklet;
+class TaskletRunner;
+
+/*!
+ * @class TaskletTrace
+ *
+ * @brief   Records the execution of the tasklets in the Chrome trace event
+ *          JSON format (chrome://tracing, Perfetto).
+ *
+ * While a trace is running, every submission, execution and progress
+ * notification of a tasklet is recorded with the thread, the runner, the
+ * tasklet class, the time spent waiting in the queues and the run time.
+ *
+ * The events are formatted into per-thread buffers and written to the file
+ * in large chunks. When no trace is running, the instrumentation boils down
+ * to a single atomic load per call site.
+ */
+class KoreExport TaskletTrace
+{
+    friend class Tasklet;
+    friend class Kore::KoreEngine;
+
+public:
+    /*!
+     * Start recording to a file, a running trace is stopped first.
+     * @param fileName path of the JSON trace file, overwritten.
+     * @return true if the file could be opened, false otherwise.
+     */
+    static kbool Start( const QString& fileName );
+    /*!
+     * Stop recording, flush all the buffers and close the file.
+     */
+    static void Stop();
+    /*!
+     * @return true if a trace is being recorded, false otherwise.
+     */
+    inline static kbool IsEnabled() { return _Enabled != 0; }
+
+private:
+    TaskletTrace();
+
+    static kint64 Now();
+
+    static void Submitted( const Tasklet* tasklet, const TaskletRunner* runner );
+    static void Ended( const Tasklet* tasklet, const QString& runner,
+                       kint state, kint64 submitted, kint64 started );
+    static void Progress( const Tasklet* tasklet, kuint64 progress,
+                          kuint64 total );
+    static void Progress( const Tasklet* tasklet, const QString& message );
+
+private:
+    static QAtomicInt _Enabled;
+};
+
+}}
@@ -0,0 +1,132 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <KoreExport.hpp>
+#include <Types.hpp>
+
+#include <QtCore/QList>
+
+namespace Kore { namespace parallel {
+
+/*!
+ * @class TimerWheel
+ *
+ * @brief   Hierarchical timer wheel, keeping any number of timers sorted by
+ *          expiry at a constant cost per timer.
+ *
+ * Time is counted in ticks. Each level of the wheel is a ring of 64 slots:
+ * the first level holds the timers expiring within 64 ticks, one slot per
+ * tick, the next one the timers expiring within 64^2 ticks, one slot per 64
+ * ticks, and so on. Every time the lower level wraps around, the next slot of
+ * the upper level is cascaded down. Inserting or removing a timer is constant
+ * time, and so is advancing the wheel by a tick.
+ *
+ * Timers further away than the range of the wheel are parked in its last
+ * level until they get in range.
+ *
+ * The wheel is not thread safe and does not own its timers.
+ */
+class KoreExport TimerWheel
+{
+public:
+    /*!
+     * A timer, to be derived to carry the data of the timed event.
+     */
+    struct Timer
+    {
+        Timer();
+
+        kuint64 expires;    //!< Tick of expiry
+        Timer*  previous;
+        Timer*  next;
+        kint    level;      //!< Level of the wheel, -1 if not in the wheel
+        kint    slot;
+    };
+
+    static const kint Levels = 4;
+    static const kint SlotBits = 6;
+    static const kint Slots = 1 << SlotBits;
+
+public:
+    /*!
+     * Constructor.
+     * @param now tick at which the wheel starts.
+     */
+    TimerWheel( kuint64 now = 0 );
+
+    /*!
+     * @return the current tick of the wheel.
+     */
+    inline kuint64 now() const { return _now; }
+    /*!
+     * @return the number of timers in the wheel.
+     */
+    inline kint size() const { return _size; }
+
+    /*!
+     * Insert a timer. A timer expiring in the past expires on the next tick.
+     * @param timer the timer, not in the wheel.
+     * @param expires tick of expiry.
+     */
+    void insert( Timer* timer, kuint64 expires );
+    /*!
+     * Remove a timer.
+     * @param timer the timer, in the wheel.
+     */
+    void remove( Timer* timer );
+
+    /*!
+     * Advance the wheel, collecting all the timers that expired. They are
+     * removed from the wheel.
+     * @param now the new current tick.
+     * @param expired filled with the expired timers, by expiry.
+     */
+    void advance( kuint64 now, QList< Timer* >& expired );
+
+    /*!
+     * @return the earliest tick at which the wheel has to be advanced, either
+     * for a timer to expire or for upper levels to be cascaded. The maximum
+     * tick if the wheel is empty.
+     */
+    kuint64 nextTick() const;
+
+private:
+    void place( Timer* timer );
+    void cascade( kint level );
+    void unlink( Timer* timer );
+
+private:
+    kuint64 _now;
+    kint    _size;
+    Timer*  _slots[ Levels ][ Slots ];
+    kuint64 _occupied[ Levels ];    //!< One bit per non empty slot
+};
+
+}}
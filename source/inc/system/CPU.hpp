@@ -39,6 +39,24 @@ namespace Kore { namespace system {
  */
 class KoreExport CPU {
 
+public:
+	/*!
+	 * @brief Instruction set extensions, as flags.
+	 */
+	enum Feature
+	{
+		NoFeature	= 0x0000,
+		MMX			= 0x0001,
+		SSE			= 0x0002,
+		SSE2		= 0x0004,
+		SSE3		= 0x0008,
+		SSE4		= 0x0010,	//!< SSE4.1
+		SSE42		= 0x0020,	//!< SSE4.2
+		AVX			= 0x0040,
+		AVX2		= 0x0080,
+		AVX512		= 0x0100	//!< AVX-512 Foundation
+	};
+
 public:
 	/*!
 	 * @brief Constructor of the CPU class.
@@ -73,6 +91,22 @@ public:
 	 * @brief Returns true if CPUs are SSE4 compliant, false otherwise.
 	 */
 	kbool	isSSE4Enabled() const;
+	/*!
+	 * @brief Returns true if CPUs are SSE4.2 compliant, false otherwise.
+	 */
+	kbool	isSSE42Enabled() const;
+	/*!
+	 * @brief Returns true if CPUs are AVX (Advanced Vector Extensions) compliant and the OS saves their state, false otherwise.
+	 */
+	kbool	isAVXEnabled() const;
+	/*!
+	 * @brief Returns true if CPUs are AVX2 compliant and the OS saves their state, false otherwise.
+	 */
+	kbool	isAVX2Enabled() const;
+	/*!
+	 * @brief Returns true if CPUs are AVX-512 Foundation compliant and the OS saves their state, false otherwise.
+	 */
+	kbool	isAVX512Enabled() const;
 	/*!
 	 * @brief Returns true if CPUs are 3DNow compliant, false otherwise.
 	 */
@@ -86,6 +120,21 @@ public:
 	 */
 	const kchar* getVendorString() const;
 
+	/*!
+	 * @brief Gets all the supported instruction set extensions, @see Feature.
+	 */
+	kuint	getFeatures() const;
+	/*!
+	 * @brief Returns true if CPUs support all the given instruction set extensions, false otherwise.
+	 * @param[in] features Combination of Feature flags.
+	 */
+	kbool	hasFeatures(kuint features) const;
+
+	/*!
+	 * @brief Returns the CPU of the host, detected once.
+	 */
+	static const CPU& Host();
+
 private:
 	void init();
 
@@ -95,6 +144,10 @@ private:
 	kbool	_SSE2;
 	kbool	_SSE3;
 	kbool	_SSE4;
+	kbool	_SSE42;
+	kbool	_AVX;
+	kbool	_AVX2;
+	kbool	_AVX512;
 	kbool	_3DNow;
 	kbool	_3DNow2;
 	kchar	_vendorString[12+1];
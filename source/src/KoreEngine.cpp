@@ -34,7 +34,9 @@ using namespace Kore::data;
 #include <event/ErrorEvent.hpp>
 using namespace Kore::event;
 
+#include <parallel/Job.hpp>
 #include <parallel/Tasklet.hpp>
+#include <parallel/TaskletTrace.hpp>
 using namespace Kore::parallel;
 
 #include <plugin/Module.hpp>
@@ -42,9 +44,8 @@ using namespace Kore::plugin;
 
 #include <QtCore/QCoreApplication>
 #include <QtCore/QDateTime>
+#include <QtCore/QPair>
 #include <QtCore/QThread>
-
-#include <QtCore/QtConcurrentRun>
 #include <QtCore/QtDebug>
 
 /* TRANSLATOR Kore::KoreEngine */
@@ -60,6 +61,8 @@ KoreEngine::KoreEngine()
 
     _modules.blockName( tr( "Modules" ) );
     addBlock( &_modules );
+
+    addBlock( &_scheduler );
 }
 
 void KoreEngine::customEvent( QEvent* event )
@@ -124,32 +127,281 @@ Block* KoreEngine::CreateBlock( const QString& name )
     return mb ? mb->createBlock() : K_NULL;
 }
 
-void KoreEngine::RunTasklet( Tasklet* tasklet, TaskletRunner::RunMode mode )
+void KoreEngine::AddTaskletRunner( const MetaTasklet* metaTasklet,
+                                   TaskletRunner* runner )
+{
+    // The meta tasklets are only exposed const, their runners are ours.
+    const_cast< MetaTasklet* >( metaTasklet )->registerTaskletRunner( runner );
+}
+
+kbool KoreEngine::RunTasklet( Tasklet* tasklet, TaskletRunner::RunMode mode,
+                              TaskletRunner::Priority priority, kint deadline )
 {
-    // Find the runner.
+    // Run again from scratch once finished.
+    tasklet->rearm();
+
+    // Known result, no runner needed at all.
+    if( tasklet->runMemoized() )
+    {
+        return true;
+    }
+
+    // Find the runner, based on what was measured so far.
     const TaskletRunner* runner = tasklet->metaTasklet()
-            ? tasklet->metaTasklet()->bestRunner()
+            ? tasklet->metaTasklet()->selectRunner( tasklet->sizeHint() )
             : K_NULL;
 
+    // Profile the execution time of the runner.
+    tasklet->_runner = runner;
+
      // Because the tasklet is its default runner as well !
     runner = runner ? runner : tasklet;
 
+    if( TaskletTrace::IsEnabled() )
+    {
+        tasklet->_traceSubmitted = TaskletTrace::Now();
+        TaskletTrace::Submitted( tasklet, runner );
+    }
+
+    kint delay = 0;
+    const TaskletRunner* hedgingRunner = K_NULL;
+
     switch( mode )
     {
     case TaskletRunner::Synchronous:
         // Run right here on the current thread.
         runner->run( tasklet );
-        break;
+        return true;
     case TaskletRunner::Asynchronous:
-        // TODO: Manage our own thread pool ? Would that be useful ?
-        // Use a future, Qt ThreadPool.
-        QtConcurrent::run( runner, &TaskletRunner::run, tasklet );
-        break;
+        // Hand it over to one of our workers.
+        hedgingRunner = HedgingRunner( tasklet, runner, &delay );
+        if( hedgingRunner )
+        {
+            return Instance()->_scheduler.scheduleHedged( tasklet, runner,
+                                                          hedgingRunner, delay,
+                                                          priority, deadline );
+        }
+        if( deadline < 0 && BatchSize( tasklet, runner ) > 1 )
+        {
+            // Waits for others of its type to share the runner's batch.
+            return Instance()->_scheduler.scheduleBatched(
+                        tasklet, runner, BatchSize( tasklet, runner ),
+                        tasklet->metaTasklet()->batchWindow(), priority );
+        }
+        return Instance()->_scheduler.schedule( tasklet, runner,
+                                                priority, deadline );
     default:
         qWarning( "Kore / Unknown running mode for tasklet %s",
                   qPrintable(tasklet->objectClassName() ) );
-        break;
+        return false;
+    }
+}
+
+QList< Tasklet* > KoreEngine::RunTasklets( const QList< Tasklet* >& tasklets,
+                                           TaskletRunner::RunMode mode,
+                                           TaskletRunner::Priority priority,
+                                           kint deadline )
+{
+    // Select the runners once per tasklet type and size bucket.
+    typedef QPair< const MetaTasklet*, kint > RunnerKey;
+    QHash< RunnerKey, const TaskletRunner* > selection;
+
+    // Fused per runner, the batches are dispatched as soon as they are full.
+    QHash< const TaskletRunner*, QList< Tasklet* > > batches;
+
+    QList< Tasklet* > pending;
+    QList< const TaskletRunner* > runners;
+    QList< Tasklet* > rejected;
+    pending.reserve( tasklets.size() );
+    runners.reserve( tasklets.size() );
+    for( kint i = 0; i < tasklets.size(); ++i )
+    {
+        Tasklet* tasklet = tasklets.at( i );
+        tasklet->rearm();
+        if( tasklet->runMemoized() )
+        {
+            continue; // Known result, no runner needed at all.
+        }
+
+        const MetaTasklet* metaTasklet = tasklet->metaTasklet();
+        const TaskletRunner* runner = K_NULL;
+        if( metaTasklet )
+        {
+            const kuint64 sizeHint = tasklet->sizeHint();
+            const RunnerKey key( metaTasklet,
+                                 MetaTasklet::SizeBucket( sizeHint ) );
+            if( selection.contains( key ) )
+            {
+                runner = selection.value( key );
+            }
+            else
+            {
+                // A probe is meant for this tasklet only.
+                kbool probe = false;
+                runner = metaTasklet->selectRunner( sizeHint, &probe );
+                if( ! probe )
+                {
+                    selection.insert( key, runner );
+                }
+            }
+        }
+
+        // Profile the execution time of the runner.
+        tasklet->_runner = runner;
+        runner = runner ? runner : tasklet;
+
+        if( TaskletTrace::IsEnabled() )
+        {
+            tasklet->_traceSubmitted = TaskletTrace::Now();
+            TaskletTrace::Submitted( tasklet, runner );
+        }
+
+        kint delay = 0;
+        const TaskletRunner* hedgingRunner =
+                ( mode == TaskletRunner::Asynchronous )
+                    ? HedgingRunner( tasklet, runner, &delay )
+                    : K_NULL;
+        if( hedgingRunner )
+        {
+            // Scheduled on its own, along with its copies.
+            if( ! Instance()->_scheduler.scheduleHedged( tasklet, runner,
+                                                         hedgingRunner, delay,
+                                                         priority, deadline ) )
+            {
+                rejected.append( tasklet );
+            }
+            continue;
+        }
+
+        const kint batchSize = ( mode == TaskletRunner::Asynchronous
+                                 && deadline < 0 )
+                ? BatchSize( tasklet, runner )
+                : 1;
+        if( batchSize > 1 )
+        {
+            QList< Tasklet* >& batch = batches[ runner ];
+            batch.append( tasklet );
+            if( batch.size() >= batchSize )
+            {
+                Instance()->_scheduler.scheduleBatch( batch, runner,
+                                                      priority );
+                batch.clear();
+            }
+            continue;
+        }
+
+        pending.append( tasklet );
+        runners.append( runner );
+    }
+
+    // What is left of the batches does not wait for more.
+    QHash< const TaskletRunner*, QList< Tasklet* > >::const_iterator it =
+            batches.constBegin();
+    for( ; it != batches.constEnd(); ++it )
+    {
+        Instance()->_scheduler.scheduleBatch( it.value(), it.key(), priority );
     }
+
+    switch( mode )
+    {
+    case TaskletRunner::Synchronous:
+        for( kint i = 0; i < pending.size(); ++i )
+        {
+            runners.at( i )->run( pending.at( i ) );
+        }
+        return rejected;
+    case TaskletRunner::Asynchronous:
+        // All at once, a single wake up round for the workers.
+        if( ! Instance()->_scheduler.schedule( pending, runners,
+                                               priority, deadline ) )
+        {
+            rejected.append( pending );
+        }
+        return rejected;
+    default:
+        qWarning( "Kore / Unknown running mode for tasklets" );
+        return pending;
+    }
+}
+
+const TaskletRunner* KoreEngine::HedgingRunner( Tasklet* tasklet,
+                                                const TaskletRunner* runner,
+                                                kint* delay )
+{
+    // Only the measured runners of a tasklet are worth hedging.
+    const MetaTasklet* metaTasklet = tasklet->metaTasklet();
+    if( ! metaTasklet || metaTasklet->hedgingPercentile() == 0
+            || ! tasklet->_runner )
+    {
+        return K_NULL;
+    }
+
+    const kuint64 sizeHint = tasklet->sizeHint();
+    const kint64 nsecs = metaTasklet->hedgingDelay( sizeHint );
+    if( nsecs < 0 )
+    {
+        return K_NULL;
+    }
+
+    // The timers have a millisecond resolution.
+    *delay = qMax( 1, static_cast< kint >(
+                ( nsecs + Q_INT64_C( 999999 ) ) / Q_INT64_C( 1000000 ) ) );
+    return metaTasklet->hedgingRunner( sizeHint, runner );
+}
+
+kint KoreEngine::BatchSize( Tasklet* tasklet, const TaskletRunner* runner )
+{
+    // Only the registered runners of a tasklet type process batches.
+    const MetaTasklet* metaTasklet = tasklet->metaTasklet();
+    if( ! metaTasklet || ! tasklet->_runner )
+    {
+        return 1;
+    }
+    return qMin( metaTasklet->batchSize(), runner->maxBatchSize() );
+}
+
+kint KoreEngine::RunTaskletAfter( Tasklet* tasklet, kint delay,
+                                  TaskletRunner::Priority priority )
+{
+    return Instance()->_scheduler.scheduleAfter( tasklet, delay, priority );
+}
+
+kint KoreEngine::RunTaskletEvery( Tasklet* tasklet, kint period,
+                                  TaskletRunner::Priority priority )
+{
+    return Instance()->_scheduler.scheduleEvery( tasklet, period, -1,
+                                                 priority );
+}
+
+kbool KoreEngine::CancelTimer( kint timer )
+{
+    return Instance()->_scheduler.cancelTimer( timer );
+}
+
+kbool KoreEngine::RunJob( Job* job, TaskletRunner::RunMode mode,
+                          TaskletRunner::Priority priority )
+{
+    // Same runner selection as the tasklets, K_NULL if the job runs itself.
+    const TaskletRunner* runner = job->metaTasklet()
+            ? job->metaTasklet()->selectRunner( job->sizeHint() )
+            : K_NULL;
+
+    switch( mode )
+    {
+    case TaskletRunner::Synchronous:
+        Job::Execute( job, runner );
+        return true;
+    case TaskletRunner::Asynchronous:
+        return Instance()->_scheduler.schedule( job, runner, priority );
+    default:
+        qWarning( "Kore / Unknown running mode for job" );
+        return false;
+    }
+}
+
+TaskletScheduler* KoreEngine::Scheduler()
+{
+    return &Instance()->_scheduler;
 }
 
 MetaBlock* KoreEngine::GetMetaBlock( const QString& name )
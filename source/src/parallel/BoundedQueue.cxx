@@ -0,0 +1,142 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+template< typename T >
+Kore::parallel::BoundedQueue< T >::BoundedQueue( kint capacity )
+    : _cells( K_NULL )
+    , _mask( 1 )
+{
+    while( _mask + 1 < capacity )
+    {
+        _mask = ( _mask << 1 ) | 1;
+    }
+
+    _cells = new Cell[ _mask + 1 ];
+    for( kint i = 0; i <= _mask; ++i )
+    {
+        _cells[ i ].sequence.fetchAndStoreRelaxed( i );
+    }
+}
+
+template< typename T >
+Kore::parallel::BoundedQueue< T >::~BoundedQueue()
+{
+    delete[] _cells;
+}
+
+template< typename T >
+kint Kore::parallel::BoundedQueue< T >::size() const
+{
+    // Briefly negative when a consumer is faster than the producer's count.
+    return qMax( static_cast< kint >( _size ), 0 );
+}
+
+template< typename T >
+kint Kore::parallel::BoundedQueue< T >::Distance( kint sequence, kuint position )
+{
+    // The positions wrap around, only their difference is meaningful.
+    return static_cast< kint >( static_cast< kuint >( sequence ) - position );
+}
+
+template< typename T >
+kbool Kore::parallel::BoundedQueue< T >::tryPush( const T& item )
+{
+    // The positions are unsigned for their arithmetic to wrap around, they
+    // are only stored as such.
+    Cell* cell;
+    kuint position = static_cast< kint >( _enqueue );
+    forever
+    {
+        cell = &_cells[ position & static_cast< kuint >( _mask ) ];
+        const kint distance =
+                Distance( cell->sequence.fetchAndAddAcquire( 0 ), position );
+        if( distance == 0 )
+        {
+            // The cell is free, claim the position.
+            if( _enqueue.testAndSetRelaxed( static_cast< kint >( position ),
+                                            static_cast< kint >( position + 1 ) ) )
+            {
+                break;
+            }
+            position = static_cast< kint >( _enqueue );
+        }
+        else if( distance < 0 )
+        {
+            return false; // Not consumed yet, the queue is full.
+        }
+        else
+        {
+            // Another producer was faster.
+            position = static_cast< kint >( _enqueue );
+        }
+    }
+
+    cell->item = item;
+    cell->sequence.fetchAndStoreRelease( static_cast< kint >( position + 1 ) );
+    _size.ref();
+    return true;
+}
+
+template< typename T >
+kbool Kore::parallel::BoundedQueue< T >::tryPop( T& item )
+{
+    Cell* cell;
+    kuint position = static_cast< kint >( _dequeue );
+    forever
+    {
+        cell = &_cells[ position & static_cast< kuint >( _mask ) ];
+        const kint distance =
+                Distance( cell->sequence.fetchAndAddAcquire( 0 ), position + 1 );
+        if( distance == 0 )
+        {
+            // The cell is written, claim the position.
+            if( _dequeue.testAndSetRelaxed( static_cast< kint >( position ),
+                                            static_cast< kint >( position + 1 ) ) )
+            {
+                break;
+            }
+            position = static_cast< kint >( _dequeue );
+        }
+        else if( distance < 0 )
+        {
+            return false; // Not produced yet, the queue is empty.
+        }
+        else
+        {
+            // Another consumer was faster.
+            position = static_cast< kint >( _dequeue );
+        }
+    }
+
+    item = cell->item;
+    cell->item = T(); // Do not hold on to the resources of the item.
+    cell->sequence.fetchAndStoreRelease(
+            static_cast< kint >( position + static_cast< kuint >( _mask ) + 1 ) );
+    _size.deref();
+    return true;
+}
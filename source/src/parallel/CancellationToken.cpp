@@ -0,0 +1,135 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <parallel/CancellationToken.hpp>
+using namespace Kore::parallel;
+
+#include <QtCore/QMutexLocker>
+
+CancellationToken::Listener::~Listener()
+{
+}
+
+CancellationToken::CancellationToken()
+    : _scope( K_NULL )
+{
+}
+
+CancellationToken::CancellationToken( Scope* parent )
+    : _scope( new Scope )
+{
+    _scope->refs = 1;
+    _scope->canceled = 0;
+    _scope->parent = parent;
+    if( parent )
+    {
+        parent->refs.ref();
+    }
+}
+
+CancellationToken::CancellationToken( const CancellationToken& other )
+    : _scope( other._scope )
+{
+    if( _scope )
+    {
+        _scope->refs.ref();
+    }
+}
+
+CancellationToken::~CancellationToken()
+{
+    Release( _scope );
+}
+
+CancellationToken& CancellationToken::operator=(
+        const CancellationToken& other )
+{
+    if( other._scope )
+    {
+        other._scope->refs.ref();
+    }
+    Release( _scope );
+    _scope = other._scope;
+    return *this;
+}
+
+CancellationToken CancellationToken::Create()
+{
+    return CancellationToken( static_cast< Scope* >( K_NULL ) );
+}
+
+CancellationToken CancellationToken::createChild() const
+{
+    return CancellationToken( _scope );
+}
+
+void CancellationToken::cancel()
+{
+    K_ASSERT( _scope )
+    _scope->canceled.fetchAndStoreOrdered( 1 );
+
+    // The listeners of the children are registered with their ancestors.
+    QMutexLocker locker( &_scope->mutex );
+    const QList< Listener* > listeners = _scope->listeners;
+    for( kint i = 0; i < listeners.size(); ++i )
+    {
+        if( _scope->listeners.contains( listeners.at( i ) ) )
+        {
+            listeners.at( i )->tokenCanceled();
+        }
+    }
+}
+
+void CancellationToken::addListener( Listener* listener ) const
+{
+    for( Scope* scope = _scope; scope; scope = scope->parent )
+    {
+        QMutexLocker locker( &scope->mutex );
+        scope->listeners.append( listener );
+    }
+}
+
+void CancellationToken::removeListener( Listener* listener ) const
+{
+    for( Scope* scope = _scope; scope; scope = scope->parent )
+    {
+        QMutexLocker locker( &scope->mutex );
+        scope->listeners.removeOne( listener );
+    }
+}
+
+void CancellationToken::Release( Scope* scope )
+{
+    // Children hold a reference on their parent.
+    while( scope && ! scope->refs.deref() )
+    {
+        Scope* parent = scope->parent;
+        delete scope;
+        scope = parent;
+    }
+}
@@ -0,0 +1,466 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <parallel/CoroutineTasklet.hpp>
+
+#ifdef _K_COROUTINES
+
+#include <parallel/TaskletScheduler.hpp>
+using namespace Kore::parallel;
+
+#include <KoreEngine.hpp>
+using namespace Kore;
+
+#include <QtCore/QAtomicPointer>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QEvent>
+#include <QtCore/QHash>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QRunnable>
+#include <QtCore/QTimerEvent>
+
+/* TRANSLATOR Kore::parallel::CoroutineTasklet */
+
+namespace {
+
+enum ReactorEvents
+{
+    DelayEvent = QEvent::User,  //!< Start a timer
+    SocketEvent,                //!< Start a socket notifier
+    InterruptEvent              //!< Drop the timers and notifiers of a coroutine
+};
+
+}
+
+/*
+ * Resumes a coroutine on a worker thread.
+ */
+class CoroutineTasklet::Resumer : public QRunnable
+{
+public:
+    Resumer( CoroutineTasklet* coroutine )
+        : _coroutine( coroutine )
+    {
+    }
+
+    virtual void run()
+    {
+        _coroutine->proceed();
+    }
+
+private:
+    CoroutineTasklet* _coroutine;
+};
+
+/*
+ * One-shot socket notifier, it does not need any slot: the activation event
+ * is caught before it turns into a signal.
+ */
+class CoroutineTasklet::Notifier : public QSocketNotifier
+{
+public:
+    Notifier( CoroutineTasklet* coroutine, int socket, Type type,
+              QObject* parent )
+        : QSocketNotifier( socket, type, parent )
+        , _coroutine( coroutine )
+    {
+    }
+
+    inline CoroutineTasklet* coroutine() const { return _coroutine; }
+
+protected:
+    virtual bool event( QEvent* e )
+    {
+        if( e->type() != QEvent::SockAct )
+        {
+            return QSocketNotifier::event( e );
+        }
+
+        setEnabled( false );
+        deleteLater();
+        _coroutine->resume();
+        return true;
+    }
+
+private:
+    CoroutineTasklet* _coroutine;
+};
+
+/*
+ * Owner of the timers and the socket notifiers of the suspended coroutines,
+ * in the application's thread.
+ */
+class CoroutineTasklet::Reactor : public QObject
+{
+private:
+    class Request : public QEvent
+    {
+    public:
+        Request( ReactorEvents type, CoroutineTasklet* c, int v, int k = 0 )
+            : QEvent( static_cast< QEvent::Type >( type ) )
+            , coroutine( c )
+            , value( v )
+            , kind( k )
+        {
+        }
+
+        CoroutineTasklet*   coroutine;
+        int                 value;  //!< Delay or socket.
+        int                 kind;   //!< Socket notifier type.
+    };
+
+public:
+    static Reactor* Instance()
+    {
+        static QAtomicPointer< Reactor > Singleton;
+        if( ! Singleton )
+        {
+            Reactor* reactor = new Reactor;
+            reactor->moveToThread( QCoreApplication::instance()->thread() );
+            if( ! Singleton.testAndSetOrdered( K_NULL, reactor ) )
+            {
+                delete reactor;
+            }
+        }
+        return Singleton;
+    }
+
+    void delay( CoroutineTasklet* coroutine, kint msecs )
+    {
+        QCoreApplication::postEvent(
+                    this, new Request( DelayEvent, coroutine, msecs ) );
+    }
+
+    void watch( CoroutineTasklet* coroutine, int socket,
+                QSocketNotifier::Type type )
+    {
+        QCoreApplication::postEvent(
+                    this, new Request( SocketEvent, coroutine, socket, type ) );
+    }
+
+    void interrupt( CoroutineTasklet* coroutine )
+    {
+        QCoreApplication::postEvent(
+                    this, new Request( InterruptEvent, coroutine, 0 ) );
+    }
+
+protected:
+    virtual void customEvent( QEvent* e )
+    {
+        Request* request = static_cast< Request* >( e );
+        switch( ( kuint ) e->type() )
+        {
+        case DelayEvent:
+            _timers.insert( startTimer( request->value ), request->coroutine );
+            break;
+        case SocketEvent:
+            new Notifier( request->coroutine, request->value,
+                          static_cast< QSocketNotifier::Type >( request->kind ),
+                          this );
+            break;
+        case InterruptEvent:
+            drop( request->coroutine );
+            break;
+        default:
+            QObject::customEvent( e );
+            return;
+        }
+        e->accept();
+    }
+
+    virtual void timerEvent( QTimerEvent* e )
+    {
+        killTimer( e->timerId() );
+        CoroutineTasklet* coroutine = _timers.take( e->timerId() );
+        if( coroutine )
+        {
+            coroutine->resume();
+        }
+    }
+
+private:
+    void drop( CoroutineTasklet* coroutine )
+    {
+        // Whatever it was waiting for, it may have come meanwhile.
+        kbool dropped = false;
+        QHash< int, CoroutineTasklet* >::iterator it = _timers.begin();
+        while( it != _timers.end() )
+        {
+            if( it.value() == coroutine )
+            {
+                killTimer( it.key() );
+                it = _timers.erase( it );
+                dropped = true;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        // The notifiers are its only children.
+        const QObjectList notifiers = children();
+        for( kint i = 0; i < notifiers.size(); ++i )
+        {
+            Notifier* notifier = static_cast< Notifier* >( notifiers.at( i ) );
+            if( notifier->coroutine() == coroutine && notifier->isEnabled() )
+            {
+                notifier->setEnabled( false );
+                notifier->deleteLater();
+                dropped = true;
+            }
+        }
+
+        if( dropped )
+        {
+            coroutine->resume();
+        }
+    }
+
+private:
+    QHash< int, CoroutineTasklet* > _timers;
+};
+
+CoroutineTasklet::TaskletAwaiter::TaskletAwaiter( CoroutineTasklet* coroutine,
+                                                  Tasklet* tasklet )
+    : _coroutine( coroutine )
+    , _tasklet( tasklet )
+    , _state( NotStarted )
+{
+}
+
+void CoroutineTasklet::TaskletAwaiter::await_suspend( std::coroutine_handle<> )
+{
+    QMutexLocker locker( &_coroutine->_suspensionMutex );
+    if( _coroutine->cancellationRequested() )
+    {
+        locker.unlock();
+        _state = Canceled;
+        _coroutine->resume();
+        return;
+    }
+    _coroutine->_awaited = _tasklet;
+    locker.unlock();
+
+    // The coroutine may be resumed before this returns, hands off from now.
+    _tasklet->addObserver( this );
+    if( ! KoreEngine::RunTasklet( _tasklet, TaskletRunner::Asynchronous ) )
+    {
+        // Rejected, it will never end on its own.
+        _tasklet->removeObserver( this );
+        _state = Canceled;
+        _coroutine->resume();
+    }
+}
+
+void CoroutineTasklet::TaskletAwaiter::taskletEnded( Tasklet* tasklet,
+                                                     kint state )
+{
+    tasklet->removeObserver( this );
+    _state = state;
+    _coroutine->resume();
+}
+
+CoroutineTasklet::DelayAwaiter::DelayAwaiter( CoroutineTasklet* coroutine,
+                                              kint msecs )
+    : _coroutine( coroutine )
+    , _msecs( msecs )
+{
+}
+
+void CoroutineTasklet::DelayAwaiter::await_suspend( std::coroutine_handle<> )
+{
+    QMutexLocker locker( &_coroutine->_suspensionMutex );
+    if( _coroutine->cancellationRequested() )
+    {
+        locker.unlock();
+        _coroutine->resume();
+        return;
+    }
+
+    // Posted locked, an interruption can not get to the reactor first.
+    _coroutine->_reacting = true;
+    Reactor::Instance()->delay( _coroutine, _msecs );
+}
+
+CoroutineTasklet::SocketAwaiter::SocketAwaiter( CoroutineTasklet* coroutine,
+                                                int socket,
+                                                QSocketNotifier::Type type )
+    : _coroutine( coroutine )
+    , _socket( socket )
+    , _type( type )
+{
+}
+
+void CoroutineTasklet::SocketAwaiter::await_suspend( std::coroutine_handle<> )
+{
+    QMutexLocker locker( &_coroutine->_suspensionMutex );
+    if( _coroutine->cancellationRequested() )
+    {
+        locker.unlock();
+        _coroutine->resume();
+        return;
+    }
+
+    _coroutine->_reacting = true;
+    Reactor::Instance()->watch( _coroutine, _socket, _type );
+}
+
+CoroutineTasklet::Coroutine::FinalAwaiter
+CoroutineTasklet::Coroutine::promise_type::final_suspend() const noexcept
+{
+    return FinalAwaiter();
+}
+
+void CoroutineTasklet::Coroutine::FinalAwaiter::await_suspend(
+        std::coroutine_handle< promise_type > handle ) noexcept
+{
+    // Suspended for good, the frame can be destroyed right away.
+    handle.promise().tasklet->finish( handle.promise().failed );
+}
+
+CoroutineTasklet::CoroutineTasklet( kbool autoDelete )
+    : Tasklet( autoDelete )
+    , _suspensionMutex( QMutex::Recursive )
+    , _awaited( K_NULL )
+    , _reacting( false )
+{
+    addFlag( Cancellable );
+}
+
+CoroutineTasklet::~CoroutineTasklet()
+{
+    if( _handle )
+    {
+        cancellationToken().removeListener( this );
+        _handle.destroy();
+    }
+}
+
+void CoroutineTasklet::cancel()
+{
+    Tasklet::cancel();
+    interrupt();
+}
+
+CoroutineTasklet::TaskletAwaiter CoroutineTasklet::runTasklet(
+        Tasklet* tasklet )
+{
+    return TaskletAwaiter( this, tasklet );
+}
+
+CoroutineTasklet::DelayAwaiter CoroutineTasklet::delay( kint msecs )
+{
+    return DelayAwaiter( this, msecs );
+}
+
+CoroutineTasklet::SocketAwaiter CoroutineTasklet::socketReady(
+        int socket, QSocketNotifier::Type type )
+{
+    return SocketAwaiter( this, socket, type );
+}
+
+QString CoroutineTasklet::runnerName() const
+{
+    return tr( "Coroutine" );
+}
+
+void CoroutineTasklet::run( Tasklet* tasklet ) const
+{
+    // Runs up to the first suspension point on the calling thread, on the
+    // workers from there on.
+    CoroutineTasklet* coroutine = static_cast< CoroutineTasklet* >( tasklet );
+    coroutine->runnerStarted();
+    coroutine->_handle = coroutine->execute().handle();
+    coroutine->cancellationToken().addListener( coroutine );
+    coroutine->proceed();
+}
+
+void CoroutineTasklet::resume()
+{
+    _suspensionMutex.lock();
+    _awaited = K_NULL;
+    _reacting = false;
+    _suspensionMutex.unlock();
+
+    KoreEngine::Scheduler()->schedule( new Resumer( this ) );
+}
+
+void CoroutineTasklet::proceed()
+{
+    if( ! keepRunning() )
+    {
+        // Canceled while suspended.
+        finish( false );
+        return;
+    }
+
+    // The tasklet might be over and gone once this returns.
+    _handle.resume();
+}
+
+void CoroutineTasklet::finish( kbool failed )
+{
+    cancellationToken().removeListener( this );
+    _handle.destroy();
+    _handle = std::coroutine_handle<>();
+
+    if( failed )
+    {
+        runnerFailed();
+    }
+    else if( keepRunning() )
+    {
+        runnerCompleted();
+    }
+    else
+    {
+        runnerCanceled();
+    }
+}
+
+void CoroutineTasklet::interrupt()
+{
+    // Resumed once what it awaits ended or was dropped.
+    QMutexLocker locker( &_suspensionMutex );
+    if( _awaited )
+    {
+        _awaited->cancel();
+    }
+    else if( _reacting )
+    {
+        Reactor::Instance()->interrupt( this );
+    }
+}
+
+void CoroutineTasklet::tokenCanceled()
+{
+    interrupt();
+}
+
+#endif // _K_COROUTINES
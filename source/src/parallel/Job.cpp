@@ -0,0 +1,278 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <parallel/Job.hpp>
+#include <parallel/JobCounter.hpp>
+#include <parallel/MetaTasklet.hpp>
+#include <parallel/TaskletRunner.hpp>
+using namespace Kore::parallel;
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QThreadStorage>
+
+#include <new>
+
+namespace {
+
+/*
+ * Jobs are allocated in blocks of 32 to 256 bytes, one pool per size. Every
+ * thread keeps a cache of free blocks and exchanges them by batches with a
+ * shared pool, so that jobs created on one thread and destroyed on another
+ * are recycled without locking most of the time. The cache of a thread is
+ * handed back to the shared pools when the thread exits.
+ */
+struct FreeBlock
+{
+    FreeBlock* next;
+};
+
+struct SharedPool
+{
+    SharedPool() : head( K_NULL ), count( 0 ) {}
+    QMutex      mutex;
+    FreeBlock*  head;
+    kint        count;
+};
+
+const kint          SizeClasses = 4;
+const std::size_t   MinBlockSize = 32;
+const kint          LocalCacheSize = 256;   // Per thread and per size
+const kint          BatchSize = 64;
+const kint          SharedPoolSize = 4096;  // Per size, beyond that freed
+
+SharedPool                  Pools[ SizeClasses ];
+_K_THREAD_LOCAL FreeBlock*  LocalHeads[ SizeClasses ];
+_K_THREAD_LOCAL kint        LocalCounts[ SizeClasses ];
+_K_THREAD_LOCAL kbool       LocalCacheTracked;
+
+/*
+ * Owned by the thread storage, destroyed by the exiting thread.
+ */
+struct LocalCache
+{
+    ~LocalCache()
+    {
+        for( kint sizeClass = 0; sizeClass < SizeClasses; ++sizeClass )
+        {
+            SharedPool& pool = Pools[ sizeClass ];
+            QMutexLocker locker( &pool.mutex );
+            while( FreeBlock* block = LocalHeads[ sizeClass ] )
+            {
+                LocalHeads[ sizeClass ] = block->next;
+                if( pool.count < SharedPoolSize )
+                {
+                    block->next = pool.head;
+                    pool.head = block;
+                    ++pool.count;
+                }
+                else
+                {
+                    ::operator delete( block );
+                }
+            }
+            LocalCounts[ sizeClass ] = 0;
+        }
+        LocalCacheTracked = false;
+    }
+};
+
+QThreadStorage< LocalCache* > LocalCaches;
+
+void TrackLocalCache()
+{
+    if( ! LocalCacheTracked )
+    {
+        LocalCacheTracked = true;
+        if( ! LocalCaches.hasLocalData() )
+        {
+            LocalCaches.setLocalData( new LocalCache );
+        }
+    }
+}
+
+kint SizeClass( std::size_t size )
+{
+    kint sizeClass = 0;
+    for( std::size_t blockSize = MinBlockSize; blockSize < size; blockSize <<= 1 )
+    {
+        ++sizeClass;
+    }
+    return sizeClass;
+}
+
+void* Allocate( std::size_t size )
+{
+    const kint sizeClass = SizeClass( size );
+    if( sizeClass >= SizeClasses )
+    {
+        return ::operator new( size );
+    }
+
+    if( ! LocalHeads[ sizeClass ] )
+    {
+        // Grab a batch from the shared pool.
+        SharedPool& pool = Pools[ sizeClass ];
+        QMutexLocker locker( &pool.mutex );
+        FreeBlock* head = pool.head;
+        FreeBlock* tail = K_NULL;
+        kint count = 0;
+        for( FreeBlock* block = head; block && count < BatchSize; block = block->next )
+        {
+            tail = block;
+            ++count;
+        }
+        if( tail )
+        {
+            TrackLocalCache();
+            pool.head = tail->next;
+            pool.count -= count;
+            tail->next = K_NULL;
+            LocalHeads[ sizeClass ] = head;
+            LocalCounts[ sizeClass ] = count;
+        }
+    }
+
+    FreeBlock* block = LocalHeads[ sizeClass ];
+    if( block )
+    {
+        LocalHeads[ sizeClass ] = block->next;
+        --LocalCounts[ sizeClass ];
+        return block;
+    }
+
+    return ::operator new( MinBlockSize << sizeClass );
+}
+
+void Release( void* memory, std::size_t size )
+{
+    const kint sizeClass = SizeClass( size );
+    if( sizeClass >= SizeClasses )
+    {
+        ::operator delete( memory );
+        return;
+    }
+
+    TrackLocalCache();
+    FreeBlock* block = static_cast< FreeBlock* >( memory );
+    block->next = LocalHeads[ sizeClass ];
+    LocalHeads[ sizeClass ] = block;
+
+    if( ++LocalCounts[ sizeClass ] > LocalCacheSize )
+    {
+        // Hand a batch over to the shared pool.
+        FreeBlock* head = LocalHeads[ sizeClass ];
+        FreeBlock* tail = head;
+        for( kint i = 1; i < BatchSize; ++i )
+        {
+            tail = tail->next;
+        }
+        LocalHeads[ sizeClass ] = tail->next;
+        LocalCounts[ sizeClass ] -= BatchSize;
+
+        SharedPool& pool = Pools[ sizeClass ];
+        QMutexLocker locker( &pool.mutex );
+        tail->next = pool.head;
+        pool.head = head;
+        pool.count += BatchSize;
+    }
+}
+
+}
+
+Job::Job( JobCounter* counter )
+    : _counter( counter )
+{
+    if( _counter )
+    {
+        _counter->add();
+    }
+}
+
+Job::~Job()
+{
+}
+
+void* Job::operator new( std::size_t size )
+{
+    return Allocate( size );
+}
+
+void Job::operator delete( void* block, std::size_t size )
+{
+    Release( block, size );
+}
+
+const MetaTasklet* Job::metaTasklet() const
+{
+    return K_NULL;
+}
+
+kuint64 Job::sizeHint() const
+{
+    return 0;
+}
+
+void Job::Execute( Job* job, const TaskletRunner* runner )
+{
+    const MetaTasklet* meta = runner ? job->metaTasklet() : K_NULL;
+    const kbool sampled = meta && meta->sampleRun( job->sizeHint() );
+
+    QElapsedTimer clock;
+    if( sampled )
+    {
+        clock.start();
+    }
+
+    if( runner )
+    {
+        runner->runJob( job );
+    }
+    else
+    {
+        job->run();
+    }
+
+    if( sampled )
+    {
+        meta->recordRun( runner, job->sizeHint(), clock.nsecsElapsed() );
+    }
+
+    Discard( job );
+}
+
+void Job::Discard( Job* job )
+{
+    // The counter is released last: once it is done, all the jobs are gone.
+    JobCounter* counter = job->_counter;
+    delete job;
+    if( counter )
+    {
+        counter->done();
+    }
+}
@@ -0,0 +1,108 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <parallel/JobCounter.hpp>
+using namespace Kore::parallel;
+
+#include <QtCore/QMutexLocker>
+#include <QtCore/QThread>
+
+namespace {
+
+// Jobs are short, give them a chance to end before going to sleep.
+const kint SpinCount = 64;
+
+}
+
+JobCounter::JobCounter()
+{
+}
+
+JobCounter::~JobCounter()
+{
+    K_ASSERT( _pending == 0 )
+}
+
+kint JobCounter::pending() const
+{
+    return _pending;
+}
+
+kbool JobCounter::isDone() const
+{
+    return _pending == 0;
+}
+
+kbool JobCounter::wait( kulong timeout )
+{
+    for( kint i = 0; i < SpinCount && ! isDone(); ++i )
+    {
+        QThread::yieldCurrentThread();
+    }
+
+    // Always synchronize with the last done(): it may still be using the
+    // counter, which the caller is about to destroy.
+    QMutexLocker locker( &_mutex );
+    if( ! isDone() )
+    {
+        _waiters.ref();
+        _condition.wait( &_mutex, timeout );
+        _waiters.deref();
+    }
+
+    return isDone();
+}
+
+void JobCounter::add()
+{
+    _pending.ref();
+}
+
+void JobCounter::done()
+{
+    forever
+    {
+        const kint pending = _pending;
+        if( pending <= 1 )
+        {
+            break;
+        }
+        if( _pending.testAndSetOrdered( pending, pending - 1 ) )
+        {
+            // Not the last one, nobody can return from wait() meanwhile.
+            return;
+        }
+    }
+
+    QMutexLocker locker( &_mutex );
+    _pending.deref();
+    if( _waiters > 0 )
+    {
+        _condition.wakeAll();
+    }
+}
@@ -0,0 +1,174 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <parallel/MapReduceTasklet.hpp>
+#include <parallel/TaskletScheduler.hpp>
+using namespace Kore::parallel;
+using namespace Kore::data;
+
+#include <KoreEngine.hpp>
+using namespace Kore;
+
+#include <QtCore/QRunnable>
+
+/* TRANSLATOR Kore::parallel::MapReduceTasklet */
+
+namespace {
+
+// Number of chunks per worker with an automatic grain, to balance the load.
+const kint ChunksPerWorker = 8;
+// Minimum automatic grain, mapping a block is usually cheaper than queuing.
+const kint MinimumGrain = 256;
+
+}
+
+class MapReduceTasklet::Walk : public QRunnable
+{
+public:
+    Walk( MapReduceTasklet* tasklet, Library* library,
+          kint begin, kint end, kint depth )
+        : _tasklet( tasklet )
+        , _library( library )
+        , _begin( begin )
+        , _end( end )
+        , _depth( depth )
+    {
+    }
+
+    virtual void run()
+    {
+        _tasklet->walk( _library, _begin, _end, _depth );
+        _tasklet->leave();
+    }
+
+private:
+    MapReduceTasklet*   _tasklet;
+    Library*            _library;
+    kint                _begin;
+    kint                _end;
+    kint                _depth;
+};
+
+MapReduceTasklet::MapReduceTasklet( Library* target, kbool typed, kint depth,
+                                    kint grain, kbool autoDelete )
+    : Tasklet( autoDelete )
+    , _target( target )
+    , _typed( typed )
+    , _depth( depth )
+    , _grain( grain )
+    , _partials( 0 )
+{
+    addFlag( Cancellable );
+}
+
+void MapReduceTasklet::grain( kint grain )
+{
+    _grain = grain;
+}
+
+QString MapReduceTasklet::runnerName() const
+{
+    return tr( "Map-reduce walker" );
+}
+
+void MapReduceTasklet::run( Tasklet* tasklet ) const
+{
+    MapReduceTasklet* mapReduce = static_cast< MapReduceTasklet* >( tasklet );
+    mapReduce->runnerStarted();
+
+    // One partial result per worker, the last one for the running thread.
+    mapReduce->_partials = KoreEngine::Scheduler()->workerCount() + 1;
+    mapReduce->resetPartials( mapReduce->_partials );
+    mapReduce->_pending.fetchAndStoreOrdered( 1 );
+
+    // The root is mapped as well, the same way Library::findChildren does.
+    Library* target = mapReduce->_target;
+    mapReduce->mapBlock( target, mapReduce->partial(), false );
+    if( mapReduce->_depth != 0 )
+    {
+        mapReduce->walk( target, 0, target->size(), mapReduce->_depth );
+    }
+    mapReduce->leave();
+}
+
+kint MapReduceTasklet::partial() const
+{
+    const kint worker = KoreEngine::Scheduler()->workerIndex();
+    return ( worker >= 0 ) ? worker : _partials - 1;
+}
+
+void MapReduceTasklet::walk( Library* library, kint begin, kint end,
+                             kint depth )
+{
+    const kint grain = ( _grain > 0 )
+            ? _grain
+            : qMax( MinimumGrain,
+                    library->size() / ( ChunksPerWorker * ( _partials - 1 ) ) );
+
+    // Keep the first half, hand the second one over to the thieves.
+    while( end - begin > grain && keepRunning() )
+    {
+        const kint middle = begin + ( end - begin ) / 2;
+        _pending.ref();
+        KoreEngine::Scheduler()->schedule(
+                    new Walk( this, library, middle, end, depth ) );
+        end = middle;
+    }
+
+    const kint index = partial();
+    const kbool typed = _typed && library == _target;
+    for( kint i = begin; i < end && keepRunning(); ++i )
+    {
+        Block* block = library->at( i );
+        mapBlock( block, index, typed );
+
+        // Nested libraries right away, they are split in turn if big enough.
+        if( block->isLibrary() && depth != 1 )
+        {
+            Library* child = static_cast< Library* >( block );
+            walk( child, 0, child->size(), depth - 1 );
+        }
+    }
+}
+
+void MapReduceTasklet::leave()
+{
+    // The last walk to end reduces the partial results and ends the tasklet.
+    if( ! _pending.deref() )
+    {
+        reducePartials();
+        if( keepRunning() )
+        {
+            runnerCompleted();
+        }
+        else
+        {
+            runnerCanceled();
+        }
+    }
+}
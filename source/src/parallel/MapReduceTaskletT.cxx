@@ -0,0 +1,151 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+template< typename T, typename R >
+Kore::parallel::MapReduceTaskletT< T, R >::MapReduceTaskletT(
+        Kore::data::LibraryT< T >* target, const R& initial, kint depth,
+        kint grain, kbool autoDelete )
+    : MapReduceTasklet( target, true, depth, grain, autoDelete )
+    , _initial( initial )
+    , _result( initial )
+    , _slots( K_NULL )
+    , _slotCount( 0 )
+{
+}
+
+template< typename T, typename R >
+Kore::parallel::MapReduceTaskletT< T, R >::MapReduceTaskletT(
+        Kore::data::Library* target, const R& initial, kint depth,
+        kint grain, kbool autoDelete )
+    : MapReduceTasklet( target, false, depth, grain, autoDelete )
+    , _initial( initial )
+    , _result( initial )
+    , _slots( K_NULL )
+    , _slotCount( 0 )
+{
+}
+
+template< typename T, typename R >
+Kore::parallel::MapReduceTaskletT< T, R >::~MapReduceTaskletT()
+{
+    delete[] _slots;
+}
+
+template< typename T, typename R >
+template< typename M, typename F >
+Kore::parallel::MapReduceTaskletT< T, R >*
+Kore::parallel::MapReduceTaskletT< T, R >::MapReduce(
+        Kore::data::LibraryT< T >* target, const R& initial, M map, F reduce,
+        kint depth, kint grain, kbool autoDelete )
+{
+    return new MapReduceFunctorTasklet< T, R, M, F >( target, initial,
+                                                      map, reduce, depth,
+                                                      grain, autoDelete );
+}
+
+template< typename T, typename R >
+template< typename M, typename F >
+Kore::parallel::MapReduceTaskletT< T, R >*
+Kore::parallel::MapReduceTaskletT< T, R >::MapReduce(
+        Kore::data::Library* target, const R& initial, M map, F reduce,
+        kint depth, kint grain, kbool autoDelete )
+{
+    return new MapReduceFunctorTasklet< T, R, M, F >( target, initial,
+                                                      map, reduce, depth,
+                                                      grain, autoDelete );
+}
+
+template< typename T, typename R >
+void Kore::parallel::MapReduceTaskletT< T, R >::resetPartials( kint count )
+{
+    if( count != _slotCount )
+    {
+        delete[] _slots;
+        _slots = new Slot[ count ];
+        _slotCount = count;
+    }
+
+    for( kint i = 0; i < count; ++i )
+    {
+        _slots[ i ].value = _initial;
+    }
+    _result = _initial;
+}
+
+template< typename T, typename R >
+void Kore::parallel::MapReduceTaskletT< T, R >::mapBlock(
+        Kore::data::Block* block, kint partial, kbool typed )
+{
+    if( typed || block->fastInherits< T >() )
+    {
+        map( static_cast< T* >( block ), _slots[ partial ].value );
+    }
+}
+
+template< typename T, typename R >
+void Kore::parallel::MapReduceTaskletT< T, R >::reducePartials()
+{
+    for( kint i = 0; i < _slotCount; ++i )
+    {
+        reduce( _result, _slots[ i ].value );
+    }
+}
+
+template< typename T, typename R, typename M, typename F >
+Kore::parallel::MapReduceFunctorTasklet< T, R, M, F >::MapReduceFunctorTasklet(
+        Kore::data::LibraryT< T >* target, const R& initial, M map, F reduce,
+        kint depth, kint grain, kbool autoDelete )
+    : MapReduceTaskletT< T, R >( target, initial, depth, grain, autoDelete )
+    , _map( map )
+    , _reduce( reduce )
+{
+}
+
+template< typename T, typename R, typename M, typename F >
+Kore::parallel::MapReduceFunctorTasklet< T, R, M, F >::MapReduceFunctorTasklet(
+        Kore::data::Library* target, const R& initial, M map, F reduce,
+        kint depth, kint grain, kbool autoDelete )
+    : MapReduceTaskletT< T, R >( target, initial, depth, grain, autoDelete )
+    , _map( map )
+    , _reduce( reduce )
+{
+}
+
+template< typename T, typename R, typename M, typename F >
+void Kore::parallel::MapReduceFunctorTasklet< T, R, M, F >::map(
+        T* block, R& partial )
+{
+    _map( block, partial );
+}
+
+template< typename T, typename R, typename M, typename F >
+void Kore::parallel::MapReduceFunctorTasklet< T, R, M, F >::reduce(
+        R& result, const R& partial )
+{
+    _reduce( result, partial );
+}
@@ -31,11 +31,43 @@
 using namespace Kore::parallel;
 using namespace Kore::data;
 
+#include <system/CPU.hpp>
+using namespace Kore::system;
+
+#include <QtCore/QReadLocker>
+#include <QtCore/QWriteLocker>
 #include <QtCore/QtDebug>
 
+#include <algorithm>
+
+namespace {
+
+// Number of runs over which the execution times are averaged, older runs fade
+// out exponentially past that.
+const kuint64 ProfileWindow = 8;
+
+// Minimum number of execution times measured before hedging a size bucket.
+const kint HedgingSamples = MetaTasklet::HedgingWindow / 4;
+
+// Once a size bucket is known, one run out of ProfileSampling is recorded:
+// timing and recording them all would cost about as much as running them.
+const kuint ProfileSampling = 16;
+_K_THREAD_LOCAL kuint ProfileTicks;
+
+// A probe run not recorded by then was lost (canceled, failed), in s.
+const kint ProbeTimeout = 2;
+
+}
+
 MetaTasklet::MetaTasklet( const QMetaObject* mo )
     : MetaBlock( mo )
+    , _explorationPeriod( 0 )
+    , _hedgingPercentile( 0 )
+    , _batchSize( DefaultBatchSize )
+    , _batchWindow( 0 )
+    , _maxConcurrency( 0 )
 {
+    _clock.start();
     blockName( tr( "MetaTasklet for %1" ).arg( mo->className() ) );
 }
 
@@ -46,6 +78,15 @@ bool RunnerLessThan( const TaskletRunner* r1, const TaskletRunner* r2 )
 
 void MetaTasklet::registerTaskletRunner( TaskletRunner* runner )
 {
+    if( ! IsSupported( runner ) )
+    {
+        qDebug() << "Kore / Ignored tasklet runner:" << runner->runnerName()
+                << "for Tasklet:" << MetaBlock::blockClassName()
+                << "as the CPU lacks some of its required features";
+        return;
+    }
+
+    QWriteLocker locker( &_profileLock );
     K_ASSERT( ! _runners.contains( runner ) )
     _runners.append( runner );
     qSort( _runners.begin(), _runners.end(), &RunnerLessThan );
@@ -56,9 +97,316 @@ void MetaTasklet::registerTaskletRunner( TaskletRunner* runner )
 
 void MetaTasklet::unregisterTaskletRunner( TaskletRunner* runner )
 {
+    if( ! IsSupported( runner ) )
+    {
+        return; // It was never registered.
+    }
+
+    QWriteLocker locker( &_profileLock );
     K_ASSERT( _runners.contains(runner) )
     _runners.removeOne( runner );
+    _profile.remove( runner );
+    _probe.fetchAndStoreOrdered( 0 ); // It might have been probing that one.
     qSort( _runners.begin(), _runners.end(), &RunnerLessThan );
-    qDebug() << "Kore / Registered tasklet runner:" << runner->runnerName()
+    qDebug() << "Kore / Unregistered tasklet runner:" << runner->runnerName()
             << "for Tasklet:" << MetaBlock::blockClassName();
 }
+
+const TaskletRunner* MetaTasklet::selectRunner( kuint64 sizeHint,
+                                               kbool* probe ) const
+{
+    QReadLocker locker( &_profileLock );
+
+    if( probe )
+    {
+        *probe = false;
+    }
+
+    if( _runners.size() < 2 )
+    {
+        return bestRunner();
+    }
+
+    const kint bucket = SizeBucket( sizeHint );
+    const TaskletRunner* best = K_NULL;
+    kdouble bestTime = 0.0;
+    for( kint i = 0; i < _runners.size(); ++i )
+    {
+        const TaskletRunner* runner = _runners.at( i );
+        Profile::const_iterator it = _profile.constFind( runner );
+        if( it == _profile.constEnd() || it.value().at( bucket ).runs == 0 )
+        {
+            // Never measured for that size, give it a try unless another
+            // probe is running already.
+            const kint now = static_cast< kint >( _clock.elapsed() / 1000 ) + 1;
+            const kint started = _probe;
+            if( ( started == 0 || now - started > ProbeTimeout )
+                    && _probe.testAndSetOrdered( started, now ) )
+            {
+                if( probe )
+                {
+                    *probe = true;
+                }
+                return runner;
+            }
+            continue;
+        }
+
+        const kdouble time = it.value().at( bucket ).average;
+        if( ! best || time < bestTime )
+        {
+            best = runner;
+            bestTime = time;
+        }
+    }
+
+    if( ! best )
+    {
+        // Nothing measured yet, while probing.
+        return bestRunner();
+    }
+
+    const kint period = _explorationPeriod;
+    if( period > 0 )
+    {
+        const kint selection = _selections.fetchAndAddRelaxed( 1 );
+        if( ( selection % period ) == period - 1 )
+        {
+            // Exploration, every runner in turn.
+            return _runners.at( ( selection / period ) % _runners.size() );
+        }
+    }
+
+    return best;
+}
+
+void MetaTasklet::explorationPeriod( kint period )
+{
+    _explorationPeriod = qMax( period, 0 );
+}
+
+kint MetaTasklet::explorationPeriod() const
+{
+    return _explorationPeriod;
+}
+
+void MetaTasklet::hedgingPercentile( kint percentile )
+{
+    _hedgingPercentile = qBound( 0, percentile, 100 );
+}
+
+kint MetaTasklet::hedgingPercentile() const
+{
+    return _hedgingPercentile;
+}
+
+kint64 MetaTasklet::hedgingDelay( kuint64 sizeHint ) const
+{
+    const kint percentile = _hedgingPercentile;
+    if( percentile == 0 )
+    {
+        return -1;
+    }
+
+    QVector< kuint64 > times;
+    {
+        QReadLocker locker( &_profileLock );
+        if( _runners.size() < 2 )
+        {
+            return -1;
+        }
+        times = _latencies.value( SizeBucket( sizeHint ) ).times;
+    }
+
+    if( times.size() < HedgingSamples )
+    {
+        return -1; // Not known well enough yet.
+    }
+
+    const kint rank = qMin( times.size() * percentile / 100, times.size() - 1 );
+    std::nth_element( times.begin(), times.begin() + rank, times.end() );
+    return static_cast< kint64 >( times.at( rank ) );
+}
+
+const TaskletRunner* MetaTasklet::hedgingRunner( kuint64 sizeHint,
+                                                 const TaskletRunner* runner ) const
+{
+    QReadLocker locker( &_profileLock );
+
+    const kint bucket = SizeBucket( sizeHint );
+    const TaskletRunner* best = K_NULL;
+    const TaskletRunner* fallback = K_NULL;
+    kdouble bestTime = 0.0;
+    for( kint i = 0; i < _runners.size(); ++i )
+    {
+        const TaskletRunner* other = _runners.at( i );
+        if( other == runner )
+        {
+            continue;
+        }
+
+        Profile::const_iterator it = _profile.constFind( other );
+        if( it == _profile.constEnd() || it.value().at( bucket ).runs == 0 )
+        {
+            // By performance score, the runners are sorted.
+            fallback = fallback ? fallback : other;
+            continue;
+        }
+
+        const kdouble time = it.value().at( bucket ).average;
+        if( ! best || time < bestTime )
+        {
+            best = other;
+            bestTime = time;
+        }
+    }
+
+    return best ? best : fallback;
+}
+
+void MetaTasklet::batching( kint size, kint window )
+{
+    _batchSize = qMax( size, 1 );
+    _batchWindow = qMax( window, 0 );
+}
+
+kint MetaTasklet::batchSize() const
+{
+    return _batchSize;
+}
+
+kint MetaTasklet::batchWindow() const
+{
+    return _batchWindow;
+}
+
+void MetaTasklet::maxConcurrency( kint limit )
+{
+    _maxConcurrency = qMax( limit, 0 );
+}
+
+kint MetaTasklet::maxConcurrency() const
+{
+    return _maxConcurrency;
+}
+
+kint MetaTasklet::inFlight() const
+{
+    return _inFlight;
+}
+
+QList< MetaTasklet::RunnerProfile > MetaTasklet::profile() const
+{
+    QReadLocker locker( &_profileLock );
+
+    QList< RunnerProfile > result;
+    for( kint i = 0; i < _runners.size(); ++i )
+    {
+        const QVector< Measure > measures = _profile.value( _runners.at( i ) );
+        for( kint bucket = 0; bucket < measures.size(); ++bucket )
+        {
+            const Measure& measure = measures.at( bucket );
+            if( measure.runs > 0 )
+            {
+                RunnerProfile entry;
+                entry.runner = _runners.at( i );
+                entry.bucket = bucket;
+                entry.runs = measure.runs;
+                entry.averageTime = static_cast< kuint64 >( measure.average );
+                result.append( entry );
+            }
+        }
+    }
+    return result;
+}
+
+void MetaTasklet::resetProfile()
+{
+    QWriteLocker locker( &_profileLock );
+    _profile.clear();
+    _latencies.clear();
+    for( kint bucket = 0; bucket < SizeBuckets; ++bucket )
+    {
+        _recorded[ bucket ].fetchAndStoreRelaxed( 0 );
+    }
+}
+
+kint MetaTasklet::SizeBucket( kuint64 sizeHint )
+{
+    kint bucket = 0;
+    while( sizeHint != 0 )
+    {
+        sizeHint >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+kbool MetaTasklet::IsSupported( const TaskletRunner* runner )
+{
+    return CPU::Host().hasFeatures( runner->requiredFeatures() );
+}
+
+kbool MetaTasklet::sampleRun( kuint64 sizeHint ) const
+{
+    // Every run while the bucket is learned or a runner probed.
+    return _recorded[ SizeBucket( sizeHint ) ] < HedgingWindow
+            || _probe != 0
+            || ( ++ProfileTicks % ProfileSampling ) == 0;
+}
+
+void MetaTasklet::recordRun( const TaskletRunner* runner,
+                             kuint64 sizeHint, kuint64 time ) const
+{
+    QWriteLocker locker( &_profileLock );
+
+    if( ! _runners.contains( runner ) )
+    {
+        return; // The tasklet ran itself or the runner is gone.
+    }
+
+    QVector< Measure >& measures = _profile[ runner ];
+    if( measures.isEmpty() )
+    {
+        measures.resize( SizeBuckets );
+    }
+
+    const kint bucket = SizeBucket( sizeHint );
+    Measure& measure = measures[ bucket ];
+    if( ++measure.runs == 1 )
+    {
+        // The probe completed, if it was one.
+        _probe.fetchAndStoreOrdered( 0 );
+    }
+    if( _recorded[ bucket ] < HedgingWindow )
+    {
+        _recorded[ bucket ].ref();
+    }
+    measure.average += ( static_cast< kdouble >( time ) - measure.average )
+            / qMin( measure.runs, ProfileWindow );
+
+    if( _hedgingPercentile > 0 )
+    {
+        addLatency( bucket, time );
+    }
+}
+
+void MetaTasklet::recordLatency( kuint64 sizeHint, kuint64 time ) const
+{
+    QWriteLocker locker( &_profileLock );
+    addLatency( SizeBucket( sizeHint ), time );
+}
+
+void MetaTasklet::addLatency( kint bucket, kuint64 time ) const
+{
+    Latencies& latencies = _latencies[ bucket ];
+    if( latencies.times.size() < HedgingWindow )
+    {
+        latencies.times.append( time );
+    }
+    else
+    {
+        latencies.times[ latencies.next ] = time;
+        latencies.next = ( latencies.next + 1 ) % HedgingWindow;
+    }
+}
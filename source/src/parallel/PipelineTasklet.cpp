@@ -0,0 +1,380 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <parallel/PipelineTasklet.hpp>
+#include <parallel/TaskletScheduler.hpp>
+using namespace Kore::parallel;
+
+#include <KoreEngine.hpp>
+using namespace Kore;
+
+#include <QtCore/QMutexLocker>
+#include <QtCore/QRunnable>
+
+/* TRANSLATOR Kore::parallel::PipelineTasklet */
+
+namespace {
+
+// Number of items a stage task processes before publishing its statistics.
+const kuint64 StatsBatch = 64;
+
+}
+
+struct PipelineTasklet::Stage
+{
+    Stage( kint p, kint c )
+        : parallelism( qMax( p, 1 ) )
+        , capacity( qMax( c, 1 ) )
+        , processed( 0 )
+        , stalls( 0 )
+    {
+    }
+
+    const kint      parallelism;
+    const kint      capacity;   //!< Of the input queue
+
+    QAtomicInt      active;     //!< Tasks running the stage
+    QAtomicInt      free;       //!< Unreserved slots of the input queue
+    QAtomicInt      queued;     //!< Items in the input queue
+
+    mutable QMutex  statsMutex;
+    kuint64         processed;
+    kuint64         stalls;
+};
+
+class PipelineTasklet::StageTask : public QRunnable
+{
+public:
+    StageTask( PipelineTasklet* pipeline, kint stage )
+        : _pipeline( pipeline )
+        , _stage( stage )
+    {
+    }
+
+    virtual void run()
+    {
+        _pipeline->drain( _stage );
+    }
+
+private:
+    PipelineTasklet*    _pipeline;
+    kint                _stage;
+};
+
+PipelineTasklet::PipelineTasklet( kbool autoDelete )
+    : Tasklet( autoDelete )
+{
+    addFlag( Cancellable );
+}
+
+PipelineTasklet::~PipelineTasklet()
+{
+    qDeleteAll( _stages );
+}
+
+void PipelineTasklet::cancel()
+{
+    Tasklet::cancel();
+    unpark();
+}
+
+kint PipelineTasklet::stageCount() const
+{
+    return _stages.size();
+}
+
+PipelineTasklet::StageStats PipelineTasklet::stageStats( kint stage ) const
+{
+    const Stage* s = _stages.at( stage );
+
+    StageStats stats;
+    stats.name = stageName( stage );
+    stats.parallelism = s->parallelism;
+    stats.active = s->active;
+
+    s->statsMutex.lock();
+    stats.processed = s->processed;
+    stats.stalls = s->stalls;
+    s->statsMutex.unlock();
+
+    const kint64 elapsed = _clock.isValid() ? _clock.nsecsElapsed() : 0;
+    stats.throughput = ( elapsed > 0 )
+            ? stats.processed * 1e9 / elapsed
+            : 0.0;
+
+    // The first stage has no input queue.
+    stats.queued = ( stage > 0 ) ? qMax( static_cast< kint >( s->queued ), 0 ) : 0;
+    stats.capacity = ( stage > 0 ) ? s->capacity : 0;
+
+    return stats;
+}
+
+void PipelineTasklet::appendStage( kint parallelism, kint capacity )
+{
+    K_ASSERT( ! isRunning() )
+    _stages.append( new Stage( parallelism, capacity ) );
+}
+
+kbool PipelineTasklet::reserve( kint stage )
+{
+    Stage* next = _stages.at( stage + 1 );
+    forever
+    {
+        const kint free = next->free;
+        if( free <= 0 )
+        {
+            return false;
+        }
+        if( next->free.testAndSetOrdered( free, free - 1 ) )
+        {
+            return true;
+        }
+    }
+}
+
+void PipelineTasklet::unreserve( kint stage )
+{
+    _stages.at( stage + 1 )->free.ref();
+}
+
+kbool PipelineTasklet::exhausted() const
+{
+    return _exhausted != 0;
+}
+
+void PipelineTasklet::exhaust()
+{
+    _exhausted.fetchAndStoreOrdered( 1 );
+    unpark();
+}
+
+void PipelineTasklet::supplied()
+{
+    _supplies.ref();
+    unpark();
+}
+
+void PipelineTasklet::produced()
+{
+    _inFlight.ref();
+}
+
+void PipelineTasklet::pushed( kint stage )
+{
+    _stages.at( stage + 1 )->queued.ref();
+    pump( stage + 1 );
+}
+
+void PipelineTasklet::popped( kint stage )
+{
+    Stage* s = _stages.at( stage );
+    s->queued.deref();
+    s->free.ref();
+
+    // Backpressure relief, the upstream stage might have stopped.
+    pump( stage - 1 );
+}
+
+void PipelineTasklet::consumed()
+{
+    _inFlight.deref();
+}
+
+QString PipelineTasklet::runnerName() const
+{
+    return tr( "Pipeline" );
+}
+
+void PipelineTasklet::run( Tasklet* tasklet ) const
+{
+    PipelineTasklet* pipeline = static_cast< PipelineTasklet* >( tasklet );
+    pipeline->runnerStarted();
+
+    if( pipeline->_stages.isEmpty() )
+    {
+        pipeline->runnerCompleted();
+        return;
+    }
+
+    pipeline->start();
+    pipeline->cancellationToken().addListener( pipeline );
+
+    // Accounted for as a stage task, the pipeline can not end before all the
+    // stages were given a chance to start.
+    pipeline->_running.ref();
+    pipeline->leave();
+}
+
+void PipelineTasklet::start()
+{
+    clear();
+
+    for( kint i = 0; i < _stages.size(); ++i )
+    {
+        Stage* stage = _stages.at( i );
+        stage->free.fetchAndStoreOrdered( stage->capacity );
+        stage->queued.fetchAndStoreOrdered( 0 );
+
+        QMutexLocker locker( &stage->statsMutex );
+        stage->processed = 0;
+        stage->stalls = 0;
+    }
+
+    _exhausted.fetchAndStoreOrdered( 0 );
+    _parked.fetchAndStoreOrdered( 0 );
+    _inFlight.fetchAndStoreOrdered( 0 );
+    _clock.start();
+}
+
+void PipelineTasklet::pump( kint stage )
+{
+    Stage* s = _stages.at( stage );
+    const kbool last = ( stage == _stages.size() - 1 );
+
+    // Start as many tasks as there are items to process, up to the parallelism.
+    forever
+    {
+        if( ! keepRunning() )
+        {
+            return;
+        }
+
+        kint available = ( stage == 0 )
+                ? ( _exhausted != 0 || _parked != 0 ? 0 : s->parallelism )
+                : static_cast< kint >( s->queued );
+        if( ! last )
+        {
+            available = qMin( available,
+                              static_cast< kint >( _stages.at( stage + 1 )->free ) );
+        }
+
+        const kint active = s->active;
+        if( active >= qMin( available, s->parallelism ) )
+        {
+            return;
+        }
+
+        if( s->active.testAndSetOrdered( active, active + 1 ) )
+        {
+            _running.ref();
+            KoreEngine::Scheduler()->schedule( new StageTask( this, stage ) );
+        }
+    }
+}
+
+void PipelineTasklet::drain( kint stage )
+{
+    Stage* s = _stages.at( stage );
+
+    kuint64 processed = 0;
+    kuint64 stalls = 0;
+    kint supplies = 0;
+    Step outcome = Processed;
+    while( keepRunning() )
+    {
+        supplies = _supplies;
+        outcome = step( stage );
+        if( outcome != Processed )
+        {
+            stalls += ( outcome == Blocked ) ? 1 : 0;
+            break;
+        }
+
+        if( ++processed == StatsBatch )
+        {
+            QMutexLocker locker( &s->statsMutex );
+            s->processed += processed;
+            processed = 0;
+        }
+    }
+
+    s->statsMutex.lock();
+    s->processed += processed;
+    s->stalls += stalls;
+    s->statsMutex.unlock();
+
+    // A starved producer would be scheduled again and again, park it. The
+    // parked stage keeps the pipeline alive: it is accounted for before it is
+    // published, for an unpark to never release the reference of this task.
+    if( stage == 0 && outcome == Starved && ! exhausted() )
+    {
+        _running.ref();
+        if( ! _parked.testAndSetOrdered( 0, 1 ) )
+        {
+            _running.deref();
+        }
+        else if( _supplies != supplies || exhausted() || ! keepRunning() )
+        {
+            // Too late, something happened since the step.
+            if( _parked.testAndSetOrdered( 1, 0 ) )
+            {
+                _running.deref();
+            }
+        }
+    }
+
+    s->active.deref();
+    leave();
+}
+
+void PipelineTasklet::unpark()
+{
+    if( _parked.testAndSetOrdered( 1, 0 ) )
+    {
+        leave();
+    }
+}
+
+void PipelineTasklet::tokenCanceled()
+{
+    unpark();
+}
+
+void PipelineTasklet::leave()
+{
+    // Whatever this task left behind is picked up by new tasks, a task that
+    // ended without work changes nothing.
+    for( kint i = 0; i < _stages.size(); ++i )
+    {
+        pump( i );
+    }
+
+    // The last task to leave ends the tasklet.
+    if( ! _running.deref() )
+    {
+        cancellationToken().removeListener( this );
+        if( keepRunning() && _exhausted != 0 && _inFlight == 0 )
+        {
+            runnerCompleted();
+        }
+        else
+        {
+            runnerCanceled();
+        }
+    }
+}
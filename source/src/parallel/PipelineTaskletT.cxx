@@ -0,0 +1,133 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <QtCore/QThread>
+
+template< typename T >
+Kore::parallel::PipelineTaskletT< T >::PipelineTaskletT( kbool autoDelete )
+    : PipelineTasklet( autoDelete )
+{
+}
+
+template< typename T >
+Kore::parallel::PipelineTaskletT< T >::~PipelineTaskletT()
+{
+    qDeleteAll( _queues );
+}
+
+template< typename T >
+void Kore::parallel::PipelineTaskletT< T >::addStage(
+        const PipelineStage< T >* stage, kint parallelism, kint capacity )
+{
+    if( ! _stages.isEmpty() )
+    {
+        _queues.append( new BoundedQueue< T >( capacity ) );
+    }
+    _stages.append( stage );
+    appendStage( parallelism, capacity );
+}
+
+template< typename T >
+Kore::parallel::PipelineTasklet::Step
+Kore::parallel::PipelineTaskletT< T >::step( kint stage )
+{
+    const kbool last = ( stage == _stages.size() - 1 );
+    if( ! last && ! reserve( stage ) )
+    {
+        return Blocked;
+    }
+
+    T item;
+    kbool forward;
+    if( stage == 0 )
+    {
+        if( exhausted() || ! _stages.at( 0 )->process( item ) )
+        {
+            exhaust();
+            if( ! last )
+            {
+                unreserve( stage );
+            }
+            return Starved;
+        }
+        produced();
+        forward = true;
+    }
+    else
+    {
+        if( ! _queues.at( stage - 1 )->tryPop( item ) )
+        {
+            if( ! last )
+            {
+                unreserve( stage );
+            }
+            return Starved;
+        }
+        popped( stage );
+        forward = _stages.at( stage )->process( item );
+    }
+
+    if( last || ! forward )
+    {
+        if( ! last )
+        {
+            unreserve( stage );
+        }
+        consumed();
+        return Processed;
+    }
+
+    // The slot is reserved, the push only fails while the consumer of that
+    // very cell is still copying the item out.
+    BoundedQueue< T >* output = _queues.at( stage );
+    while( ! output->tryPush( item ) )
+    {
+        QThread::yieldCurrentThread();
+    }
+    pushed( stage );
+
+    return Processed;
+}
+
+template< typename T >
+QString Kore::parallel::PipelineTaskletT< T >::stageName( kint stage ) const
+{
+    return _stages.at( stage )->stageName();
+}
+
+template< typename T >
+void Kore::parallel::PipelineTaskletT< T >::clear()
+{
+    T item;
+    for( kint i = 0; i < _queues.size(); ++i )
+    {
+        while( _queues.at( i )->tryPop( item ) )
+        {
+        }
+    }
+}
@@ -0,0 +1,189 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <parallel/RangeTasklet.hpp>
+#include <parallel/TaskletScheduler.hpp>
+using namespace Kore::parallel;
+using namespace Kore::data;
+
+#include <KoreEngine.hpp>
+using namespace Kore;
+
+#include <QtCore/QRunnable>
+
+/* TRANSLATOR Kore::parallel::RangeTasklet */
+
+namespace {
+
+// Number of chunks per worker with an automatic grain, to balance the load.
+const kint ChunksPerWorker = 8;
+
+}
+
+class RangeTasklet::Chunk : public QRunnable
+{
+public:
+    Chunk( RangeTasklet* tasklet, kint begin, kint end )
+        : _tasklet( tasklet )
+        , _begin( begin )
+        , _end( end )
+    {
+    }
+
+    virtual void run()
+    {
+        _tasklet->split( _begin, _end );
+    }
+
+private:
+    RangeTasklet*   _tasklet;
+    kint            _begin;
+    kint            _end;
+};
+
+RangeTasklet::RangeTasklet( kint begin, kint end, kint grain,
+                            kbool autoDelete )
+    : Tasklet( autoDelete )
+    , _target( K_NULL )
+    , _begin( begin )
+    , _end( end )
+    , _grain( grain )
+    , _total( 0 )
+    , _chunk( 1 )
+{
+    addFlag( Cancellable );
+}
+
+RangeTasklet::RangeTasklet( Library* target, kint grain, kbool autoDelete )
+    : Tasklet( autoDelete )
+    , _target( target )
+    , _begin( 0 )
+    , _end( 0 )
+    , _grain( grain )
+    , _total( 0 )
+    , _chunk( 1 )
+{
+    addFlag( Cancellable );
+}
+
+void RangeTasklet::grain( kint grain )
+{
+    _grain = grain;
+}
+
+QString RangeTasklet::runnerName() const
+{
+    return tr( "Range splitter" );
+}
+
+void RangeTasklet::run( Tasklet* tasklet ) const
+{
+    RangeTasklet* range = static_cast< RangeTasklet* >( tasklet );
+    range->runnerStarted();
+
+    // The library might have changed since the tasklet was created.
+    const kint begin = range->_begin;
+    const kint end = range->_target ? range->_target->size() : range->_end;
+
+    range->_total = qMax( end - begin, 0 );
+    if( range->_total == 0 )
+    {
+        range->runnerCompleted();
+        return;
+    }
+
+    range->_chunk = ( range->_grain > 0 )
+            ? range->_grain
+            : qMax( 1, range->_total / ( ChunksPerWorker
+                        * KoreEngine::Scheduler()->workerCount() ) );
+
+    range->_remaining.fetchAndStoreOrdered( range->_total );
+    range->split( begin, end );
+}
+
+void RangeTasklet::split( kint begin, kint end )
+{
+    // Keep the first half, hand the second one over to the thieves.
+    while( end - begin > _chunk && keepRunning() )
+    {
+        const kint middle = begin + ( end - begin ) / 2;
+        KoreEngine::Scheduler()->schedule( new Chunk( this, middle, end ) );
+        end = middle;
+    }
+
+    process( begin, end );
+}
+
+void RangeTasklet::process( kint begin, kint end )
+{
+    for( kint i = begin; i < end && keepRunning(); ++i )
+    {
+        runElement( i );
+    }
+
+    const kint count = end - begin;
+    if( count < _total )
+    {
+        // Approximate, the other chunks are moving on concurrently.
+        runnerProgress( _total - _remaining + count, _total );
+    }
+
+    // The last chunk to end ends the tasklet.
+    if( _remaining.fetchAndAddOrdered( -count ) == count )
+    {
+        if( keepRunning() )
+        {
+            runnerCompleted();
+        }
+        else
+        {
+            runnerCanceled();
+        }
+    }
+}
+
+RangeRunnerTasklet::RangeRunnerTasklet( Library* target,
+                                        const TaskletRunner* runner,
+                                        kint grain, kbool autoDelete )
+    : RangeTasklet( target, grain, autoDelete )
+    , _runner( runner )
+{
+}
+
+void RangeRunnerTasklet::runElement( kint index )
+{
+    Tasklet* tasklet = target()->at< Tasklet >( index );
+    if( _runner )
+    {
+        _runner->run( tasklet );
+    }
+    else
+    {
+        KoreEngine::RunTasklet( tasklet, TaskletRunner::Synchronous );
+    }
+}
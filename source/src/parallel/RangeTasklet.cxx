@@ -0,0 +1,59 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+template< typename T, typename F >
+Kore::parallel::RangeFunctorTasklet< T, F >::RangeFunctorTasklet(
+        Kore::data::Library* target, F functor, kint grain, kbool autoDelete )
+    : RangeTasklet( target, grain, autoDelete )
+    , _functor( functor )
+{
+}
+
+template< typename T, typename F >
+void Kore::parallel::RangeFunctorTasklet< T, F >::runElement( kint index )
+{
+    _functor( target()->at< T >( index ) );
+}
+
+template< typename T, typename F >
+Kore::parallel::RangeTasklet* Kore::parallel::RangeTasklet::ForEach(
+        Kore::data::LibraryT< T >* target, F functor, kint grain,
+        kbool autoDelete )
+{
+    return new RangeFunctorTasklet< T, F >( target, functor, grain,
+                                            autoDelete );
+}
+
+template< typename T, typename F >
+Kore::parallel::RangeTasklet* Kore::parallel::RangeTasklet::ForEach(
+        Kore::data::Library* target, F functor, kint grain,
+        kbool autoDelete )
+{
+    return new RangeFunctorTasklet< T, F >( target, functor, grain,
+                                            autoDelete );
+}
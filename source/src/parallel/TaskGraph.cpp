@@ -0,0 +1,375 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <parallel/TaskGraph.hpp>
+using namespace Kore::parallel;
+
+#include <KoreEngine.hpp>
+using namespace Kore;
+
+#include <QtCore/QVector>
+
+/* TRANSLATOR Kore::parallel::TaskGraph */
+
+struct TaskGraph::Node
+{
+    enum Status
+    {
+        Waiting = 0x0,  //!< Some predecessors did not end yet
+        Scheduled,      //!< Handed over to the scheduler
+        Ended,          //!< Ended after being scheduled
+        Skipped         //!< Will never run
+    };
+
+    Node( Tasklet* t, kint p )
+        : tasklet( t )
+        , position( p )
+        , predecessors( 0 )
+    {
+    }
+
+    Tasklet* const  tasklet;
+    const kint      position;
+    QList< Node* >  successors;
+    kint            predecessors;
+
+    QAtomicInt      pending;    //!< Predecessors not ended yet
+    QAtomicInt      poisoned;   //!< A predecessor did not complete
+    QAtomicInt      status;
+};
+
+TaskGraph::TaskGraph( kbool autoDelete )
+    : Tasklet( autoDelete )
+{
+    blockName( tr( "Task graph" ) );
+}
+
+TaskGraph::~TaskGraph()
+{
+    clear();
+}
+
+void TaskGraph::addTasklet( Tasklet* tasklet )
+{
+    K_ASSERT( ! isRunning() )
+    K_ASSERT( tasklet != this )
+
+    if( _index.contains( tasklet ) )
+    {
+        return;
+    }
+
+    Node* node = new Node( tasklet, _nodes.size() );
+    _nodes.append( node );
+    _index.insert( tasklet, node );
+
+    tasklet->addObserver( this );
+}
+
+void TaskGraph::addTasklet( Tasklet* tasklet,
+                            const QList< Tasklet* >& predecessors )
+{
+    addTasklet( tasklet );
+    for( kint i = 0; i < predecessors.size(); ++i )
+    {
+        addDependency( predecessors.at( i ), tasklet );
+    }
+}
+
+void TaskGraph::addDependency( Tasklet* predecessor, Tasklet* successor )
+{
+    K_ASSERT( predecessor != successor )
+
+    addTasklet( predecessor );
+    addTasklet( successor );
+
+    Node* from = _index.value( predecessor );
+    Node* to = _index.value( successor );
+    if( ! from->successors.contains( to ) )
+    {
+        from->successors.append( to );
+        ++to->predecessors;
+    }
+}
+
+void TaskGraph::clear()
+{
+    K_ASSERT( ! isRunning() )
+
+    for( kint i = 0; i < _nodes.size(); ++i )
+    {
+        _nodes.at( i )->tasklet->removeObserver( this );
+    }
+
+    qDeleteAll( _nodes );
+    _nodes.clear();
+    _index.clear();
+}
+
+void TaskGraph::cancel()
+{
+    _aborted = 1;
+    Tasklet::cancel();
+
+    if( _remaining == 0 )
+    {
+        return; // Not running (yet), execute will take care of it.
+    }
+
+    for( kint i = 0; i < _nodes.size(); ++i )
+    {
+        Node* node = _nodes.at( i );
+        if( node->status.testAndSetOrdered( Node::Waiting, Node::Skipped ) )
+        {
+            node->tasklet->runnerSkipped();
+            if( settle( node, false ) )
+            {
+                return; // That was the last one, the graph is over.
+            }
+        }
+        else if( node->status == Node::Scheduled )
+        {
+            node->tasklet->cancel();
+        }
+    }
+}
+
+QString TaskGraph::runnerName() const
+{
+    return tr( "Task graph dispatcher" );
+}
+
+void TaskGraph::run( Tasklet* tasklet ) const
+{
+    // The graph is the runner of itself as well as the dispatcher of its
+    // tasklets on the worker threads.
+    TaskGraph* graph = const_cast< TaskGraph* >( this );
+    if( tasklet == this )
+    {
+        graph->execute();
+    }
+    else
+    {
+        graph->dispatch( _index.value( tasklet ) );
+    }
+}
+
+void TaskGraph::taskletEnded( Tasklet* tasklet, kint state )
+{
+    Node* node = _index.value( tasklet, K_NULL );
+
+    // Only account for the tasklets we scheduled, the skipped ones are
+    // accounted for by whoever skipped them.
+    if( node && node->status.testAndSetOrdered( Node::Scheduled, Node::Ended ) )
+    {
+        if( state != Completed )
+        {
+            _failed.ref();
+        }
+        settle( node, state == Completed );
+    }
+}
+
+kbool TaskGraph::isAcyclic() const
+{
+    // Kahn's algorithm: peel off the roots until nothing is left.
+    QVector< kint > predecessors( _nodes.size() );
+    QList< const Node* > roots;
+    for( kint i = 0; i < _nodes.size(); ++i )
+    {
+        predecessors[ i ] = _nodes.at( i )->predecessors;
+        if( predecessors.at( i ) == 0 )
+        {
+            roots.append( _nodes.at( i ) );
+        }
+    }
+
+    kint visited = 0;
+    while( ! roots.isEmpty() )
+    {
+        const Node* node = roots.takeLast();
+        ++visited;
+        for( kint i = 0; i < node->successors.size(); ++i )
+        {
+            const Node* successor = node->successors.at( i );
+            if( --predecessors[ successor->position ] == 0 )
+            {
+                roots.append( successor );
+            }
+        }
+    }
+
+    return visited == _nodes.size();
+}
+
+kbool TaskGraph::aborted() const
+{
+    return _aborted != 0 || cancellationToken().isCanceled();
+}
+
+void TaskGraph::execute()
+{
+    runnerStarted();
+
+    if( ! isAcyclic() )
+    {
+        qWarning( "Kore / The task graph %s has a dependency cycle",
+                  qPrintable( blockName() ) );
+        runnerFailed();
+        return;
+    }
+
+    if( ( _aborted.fetchAndStoreOrdered( 0 ) != 0 )
+            || cancellationToken().isCanceled() )
+    {
+        // Canceled before it even started.
+        runnerCanceled();
+        return;
+    }
+
+    if( _nodes.isEmpty() )
+    {
+        runnerCompleted();
+        return;
+    }
+
+    _ended = 0;
+    _failed = 0;
+    for( kint i = 0; i < _nodes.size(); ++i )
+    {
+        Node* node = _nodes.at( i );
+        node->pending = node->predecessors;
+        node->poisoned = 0;
+        node->status = Node::Waiting;
+    }
+    _remaining.fetchAndStoreOrdered( _nodes.size() );
+
+    // Collect the roots first: as soon as one is released, the graph might
+    // complete from another thread.
+    QList< Node* > roots;
+    for( kint i = 0; i < _nodes.size(); ++i )
+    {
+        if( _nodes.at( i )->predecessors == 0 )
+        {
+            roots.append( _nodes.at( i ) );
+        }
+    }
+    for( kint i = 0; i < roots.size(); ++i )
+    {
+        release( roots.at( i ) );
+    }
+}
+
+void TaskGraph::dispatch( Node* node )
+{
+    if( aborted() )
+    {
+        // Canceled while it was queued.
+        node->tasklet->runnerSkipped();
+        return;
+    }
+
+    KoreEngine::RunTasklet( node->tasklet, TaskletRunner::Synchronous );
+}
+
+void TaskGraph::release( Node* node )
+{
+    if( node->status.testAndSetOrdered( Node::Waiting, Node::Scheduled ) )
+    {
+        // The graph was admitted as a whole, its nodes are not rejected.
+        KoreEngine::Scheduler()->scheduleContinuation( node->tasklet, this );
+    }
+}
+
+kbool TaskGraph::settle( Node* node, kbool completed )
+{
+    // Iterative, skipping long chains of successors must not blow the stack.
+    QList< Node* > skipped;
+    forever
+    {
+        for( kint i = 0; i < node->successors.size(); ++i )
+        {
+            Node* successor = node->successors.at( i );
+            if( ! completed )
+            {
+                successor->poisoned = 1;
+            }
+            if( ! successor->pending.deref() )
+            {
+                // That was its last predecessor.
+                if( successor->poisoned != 0 || aborted() )
+                {
+                    if( successor->status.testAndSetOrdered( Node::Waiting,
+                                                             Node::Skipped ) )
+                    {
+                        skipped.append( successor );
+                    }
+                }
+                else
+                {
+                    release( successor );
+                }
+            }
+        }
+
+        runnerProgress( _ended.fetchAndAddOrdered( 1 ) + 1, _nodes.size() );
+
+        if( ! _remaining.deref() )
+        {
+            // Nothing can be left in skipped, they were not accounted for.
+            finish();
+            return true;
+        }
+
+        if( skipped.isEmpty() )
+        {
+            return false;
+        }
+
+        node = skipped.takeLast();
+        completed = false;
+        node->tasklet->runnerSkipped();
+    }
+}
+
+void TaskGraph::finish()
+{
+    if( ( _aborted.fetchAndStoreOrdered( 0 ) != 0 )
+            || cancellationToken().isCanceled() )
+    {
+        runnerCanceled();
+    }
+    else if( _failed != 0 )
+    {
+        runnerFailed();
+    }
+    else
+    {
+        runnerCompleted();
+    }
+}
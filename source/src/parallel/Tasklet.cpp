@@ -27,12 +27,18 @@
  */
 
 #include <parallel/Tasklet.hpp>
+#include <parallel/TaskletObserver.hpp>
+#include <parallel/TaskletCache.hpp>
 #include <parallel/TaskletRunner.hpp>
+#include <parallel/TaskletTrace.hpp>
 using namespace Kore::parallel;
 
+#include <QtCore/QAtomicPointer>
 #include <QtCore/QCoreApplication>
+#include <QtCore/QHash>
 #include <QtCore/QMutexLocker>
 #include <QtCore/QThread>
+#include <QtCore/QTimerEvent>
 
 /* TRANSLATOR Kore::parallel::Tasklet */
 
@@ -41,40 +47,16 @@ namespace {
 enum Events
 {
     StartedEvent = QEvent::User,    //!< Execution started event
-    ProgressRangeEvent,             //!< Progress range event
-    ProgressMessageEvent,           //!< Progress message event
+    ProgressEvent,                  //!< Pending progress event
     CanceledEvent,                  //!< Execution was canceled event
     FailedEvent,                    //!< Execution failed event
     CompletedEvent                  //!< Execution successfully completed event
 };
 
-class ProgressEvent : public QEvent
+enum ProgressKinds
 {
-public:
-    ProgressEvent( const QString& message )
-        : QEvent( static_cast< QEvent::Type >( ProgressMessageEvent ) )
-        , _progress( 0 )
-        , _total( 0 )
-        , _message( message )
-    {
-    }
-
-    ProgressEvent( kuint64 progress, kuint64 total )
-        : QEvent( static_cast< QEvent::Type >( ProgressRangeEvent ) )
-        , _progress( progress )
-        , _total( total )
-    {
-    }
-
-public:
-    const QString& message() const { return _message; }
-    kuint64 progress() const { return _progress; }
-    kuint64 total() const { return _total; }
-
-private:
-    kuint64 _progress;
-    kuint64 _total;
-    QString _message;
+    ProgressRange   = 0x1,  //!< The progress range changed
+    ProgressMessage = 0x2   //!< The progress message changed
 };
 
 void sendEvent( QObject* target, int eventType )
@@ -91,12 +73,162 @@ void postEvent( QObject* target, int eventType )
                 Qt::HighEventPriority );
 }
 
+/*
+ * Waits for a number of tasklets of a set to be finished, counting them down
+ * on a single counter. Each tasklet is only counted once, whether it was seen
+ * finished by the waiter or notified by its runner.
+ */
+class GroupWaiter : public TaskletObserver
+{
+public:
+    GroupWaiter( const QList< Tasklet* >& tasklets, kbool any )
+        : _first( K_NULL )
+    {
+        for( kint i = 0; i < tasklets.size(); ++i )
+        {
+            if( ! _indexes.contains( tasklets.at( i ) ) )
+            {
+                _indexes.insert( tasklets.at( i ), _indexes.size() );
+            }
+        }
+
+        _ended = new QAtomicInt[ _indexes.size() ];
+        _remaining.fetchAndStoreOrdered( _indexes.size() );
+        _target = any ? _indexes.size() - 1 : 0;
+    }
+
+    virtual ~GroupWaiter()
+    {
+        delete[] _ended;
+    }
+
+    virtual void taskletEnded( Tasklet* tasklet, kint )
+    {
+        end( tasklet );
+    }
+
+    kbool wait( kulong timeout )
+    {
+        QList< Tasklet* > tasklets = _indexes.keys();
+
+        // The state of a tasklet is set before its observers are notified:
+        // once registered, a tasklet that is not seen ended notifies us.
+        for( kint i = 0; i < tasklets.size(); ++i )
+        {
+            tasklets.at( i )->addObserver( this );
+        }
+        for( kint i = 0; i < tasklets.size() && ! isDone(); ++i )
+        {
+            if( tasklets.at( i )->state() >= Tasklet::Canceled )
+            {
+                end( tasklets.at( i ) );
+            }
+        }
+
+        if( ! isDone() )
+        {
+            QElapsedTimer clock;
+            clock.start();
+
+            QMutexLocker locker( &_mutex );
+            _waiters.ref();
+            while( ! isDone() )
+            {
+                if( timeout == ULONG_MAX )
+                {
+                    _condition.wait( &_mutex );
+                    continue;
+                }
+
+                const kulong elapsed = static_cast< kulong >( clock.elapsed() );
+                if( elapsed >= timeout
+                        || ! _condition.wait( &_mutex, timeout - elapsed ) )
+                {
+                    break;
+                }
+            }
+            _waiters.deref();
+        }
+
+        // Once removed, we are guaranteed not to be notified anymore.
+        for( kint i = 0; i < tasklets.size(); ++i )
+        {
+            tasklets.at( i )->removeObserver( this );
+        }
+
+        if( ! isDone() )
+        {
+            return false;
+        }
+
+        // Ended, their runners are only notifying about it: not for long.
+        for( kint i = 0; i < tasklets.size(); ++i )
+        {
+            Tasklet* tasklet = tasklets.at( i );
+            if( _target == 0 || tasklet == _first )
+            {
+                while( ! tasklet->isFinished() )
+                {
+                    QThread::yieldCurrentThread();
+                }
+            }
+        }
+        return true;
+    }
+
+    inline kbool isDone() const { return _remaining <= _target; }
+    inline Tasklet* first() const { return _first; }
+
+private:
+    void end( Tasklet* tasklet )
+    {
+        const kint index = _indexes.value( tasklet, -1 );
+        if( index < 0 || ! _ended[ index ].testAndSetOrdered( 0, 1 ) )
+        {
+            return; // Already counted.
+        }
+
+        _first.testAndSetOrdered( K_NULL, tasklet );
+        if( _remaining.fetchAndAddOrdered( -1 ) - 1 == _target && _waiters > 0 )
+        {
+            QMutexLocker locker( &_mutex );
+            _condition.wakeAll();
+        }
+    }
+
+private:
+    QHash< Tasklet*, kint >     _indexes;
+    QAtomicInt*                 _ended;
+    QAtomicInt                  _remaining;
+    kint                        _target;
+    QAtomicPointer< Tasklet >   _first;
+
+    QAtomicInt                  _waiters;
+    QMutex                      _mutex;
+    QWaitCondition              _condition;
+};
+
 }
 
 Tasklet::Tasklet(kbool autoDelete)
     : _autoDelete( autoDelete )
     , _state( NotStarted )
+    , _endingThread( K_NULL )
+    , _runner( K_NULL )
+    , _affinityKey( 0 )
+    , _traceSubmitted( -1 )
+    , _traceStarted( -1 )
+    , _observersMutex( QMutex::Recursive )
+    , _progress( 0 )
+    , _progressTotal( 0 )
+    , _progressInterval( 0 )
+    , _progressTimer( 0 )
 {
+    // Nobody will ever dispatch our events.
+    if( ! QCoreApplication::instance() )
+    {
+        addFlag( Headless );
+    }
 }
 
 Tasklet::~Tasklet()
@@ -106,6 +238,16 @@ Tasklet::~Tasklet()
         // The Tasklet was created on the stack ! // ???? What is that for :/
         addFlag( IsBeingDeleted );
     }
+
+    // Whoever still observes it would otherwise wait for its end forever.
+    _observersMutex.lock();
+    const QList< TaskletObserver* > observers = _observers;
+    _observers.clear();
+    _observersMutex.unlock();
+    for( kint i = 0; i < observers.size(); ++i )
+    {
+        observers.at( i )->taskletDestroyed( this );
+    }
 }
 
 QString Tasklet::runnerName() const
@@ -126,25 +268,178 @@ void Tasklet::run( Tasklet* ) const
 
 kbool Tasklet::waitForFinished( kulong timeout )
 {
+    // Fast path, no locking at all when the tasklet is over.
+    if( isFinished() )
+    {
+        return true;
+    }
+
     QMutexLocker locker( &_waitMutex );
+
+    // Registering as a waiter before checking the state again guarantees that
+    // the runner either sees us or we see its final state.
+    _waiters.ref();
+    if( _state < Canceled )
+    {
+        _waitForFinished.wait( &_waitMutex, timeout );
+    }
+    _waiters.deref();
+    locker.unlock();
+
     if( _state < Canceled )
     {
-        // Wait on the wait condition.
-        return _waitForFinished.wait( &_waitMutex, timeout );
+        return false;
+    }
+
+    // Ended, the runner is only notifying about it: not for long.
+    while( ! isFinished() )
+    {
+        QThread::yieldCurrentThread();
     }
     return true;
 }
 
+kbool Tasklet::WaitForAll( const QList< Tasklet* >& tasklets, kulong timeout )
+{
+    // Fast path, no locking at all when all the tasklets are over.
+    kint i = 0;
+    while( i < tasklets.size() && tasklets.at( i )->isFinished() )
+    {
+        ++i;
+    }
+    if( i == tasklets.size() )
+    {
+        return true;
+    }
+
+    GroupWaiter waiter( tasklets.mid( i ), false );
+    return waiter.wait( timeout );
+}
+
+Tasklet* Tasklet::WaitForAny( const QList< Tasklet* >& tasklets, kulong timeout )
+{
+    // Fast path, no locking at all when one of the tasklets is over.
+    for( kint i = 0; i < tasklets.size(); ++i )
+    {
+        if( tasklets.at( i )->isFinished() )
+        {
+            return tasklets.at( i );
+        }
+    }
+    if( tasklets.isEmpty() )
+    {
+        return K_NULL;
+    }
+
+    GroupWaiter waiter( tasklets, true );
+    return waiter.wait( timeout ) ? waiter.first() : K_NULL;
+}
+
 kbool Tasklet::isRunning() const
 {
     return _state == Running;
 }
 
+kbool Tasklet::isFinished() const
+{
+    if( _state < Canceled )
+    {
+        return false;
+    }
+
+    // The thread ending it sees it finished already, from its observers.
+    const QThread* ending = _endingThread;
+    return ! ending || ending == QThread::currentThread();
+}
+
+Tasklet::State Tasklet::state() const
+{
+    return static_cast< State >( static_cast< kint >( _state ) );
+}
+
+void Tasklet::addObserver( TaskletObserver* observer )
+{
+    QMutexLocker locker( &_observersMutex );
+    K_ASSERT( ! _observers.contains( observer ) )
+    _observers.append( observer );
+}
+
+void Tasklet::removeObserver( TaskletObserver* observer )
+{
+    QMutexLocker locker( &_observersMutex );
+    _observers.removeOne( observer );
+}
+
+kuint64 Tasklet::sizeHint() const
+{
+    return 0;
+}
+
+QVariant Tasklet::memoizedResult() const
+{
+    return QVariant();
+}
+
+void Tasklet::memoizedResult( const QVariant& )
+{
+}
+
+Tasklet* Tasklet::hedgedCopy() const
+{
+    return K_NULL;
+}
+
+void Tasklet::hedgedResult( Tasklet* )
+{
+}
+
+void Tasklet::headless( kbool headless )
+{
+    K_ASSERT( ! isRunning() )
+    if( headless )
+    {
+        addFlag( Headless );
+    }
+    else
+    {
+        removeFlag( Headless );
+    }
+}
+
+kbool Tasklet::isHeadless() const
+{
+    return checkFlag( Headless );
+}
+
+void Tasklet::affinityKey( kid key )
+{
+    _affinityKey = key;
+}
+
+kid Tasklet::affinityKey() const
+{
+    return _affinityKey;
+}
+
+void Tasklet::progressInterval( kint msecs )
+{
+    _progressInterval = qMax( msecs, 0 );
+}
+
+kint Tasklet::progressInterval() const
+{
+    return _progressInterval;
+}
+
 void Tasklet::cancel()
 {
-    // XXX: We might have to use something stronger for that, such as
-    // QAtomicInt or a specific mutex.
-    _state = Aborted;
+    // Recorded even between two runs, see rearm(). Only a pending or running
+    // execution can be aborted.
+    _cancelRequested.fetchAndStoreOrdered( 1 );
+    if( ! _state.testAndSetOrdered( Running, Aborted ) )
+    {
+        _state.testAndSetOrdered( NotStarted, Aborted );
+    }
 }
 
 kbool Tasklet::isCancellable() const
@@ -152,6 +447,23 @@ kbool Tasklet::isCancellable() const
     return checkFlag( Cancellable );
 }
 
+void Tasklet::cancellationToken( const CancellationToken& token )
+{
+    K_ASSERT( ! isRunning() )
+    _cancellationToken = token;
+}
+
+const CancellationToken& Tasklet::cancellationToken() const
+{
+    return _cancellationToken;
+}
+
+kbool Tasklet::cancellationRequested() const
+{
+    return _state == Aborted || _cancelRequested != 0
+            || _cancellationToken.isCanceled();
+}
+
 const MetaTasklet* Tasklet::metaTasklet() const
 {
     return K_NULL;
@@ -159,33 +471,45 @@ const MetaTasklet* Tasklet::metaTasklet() const
 
 void Tasklet::customEvent( QEvent* e )
 {
+    // The state was set by the runner already, it might even have been
+    // started again since.
+    State state = NotStarted;
+
     switch( ( kuint ) e->type() )
     {
     case StartedEvent:
         e->accept();
-        _state = Running;
         emit started();
         return; // We return !
-    case ProgressMessageEvent:
-        emit progress( static_cast< ProgressEvent* >( e )->message() );
-        return;
-    case ProgressRangeEvent:
+    case ProgressEvent:
+        e->accept();
+        if( _progressTimer == 0 )
         {
-            ProgressEvent* event = static_cast< ProgressEvent* >( e );
-            emit progress( event->progress(), event->total() );
+            const qint64 delay = _progressClock.isValid()
+                    ? _progressInterval - _progressClock.elapsed()
+                    : 0;
+            if( delay > 0 )
+            {
+                // Too early, the pending progress is kept until then.
+                _progressTimer = startTimer( static_cast< kint >( delay ) );
+            }
+            else
+            {
+                deliverProgress();
+            }
         }
         return;
     case CanceledEvent:
         e->accept();
-        _state = Canceled;
+        state = Canceled;
         break;
     case FailedEvent:
         e->accept();
-        _state = Failed;
+        state = Failed;
         break;
     case CompletedEvent:
         e->accept();
-        _state = Completed;
+        state = Completed;
         break;
     default:
         Block::customEvent( e );
@@ -193,20 +517,54 @@ void Tasklet::customEvent( QEvent* e )
     }
 
     // Just to factor code, for Canceled/Failed/Completed events.
-    emit ended( _state );
+    // The last progress always comes before the ended signal.
+    if( _progressTimer != 0 )
+    {
+        killTimer( _progressTimer );
+        _progressTimer = 0;
+    }
+    deliverProgress();
+
+    emit ended( state );
     if( _autoDelete )
     {
         destroy();
     }
 }
 
+void Tasklet::timerEvent( QTimerEvent* e )
+{
+    if( e->timerId() != _progressTimer )
+    {
+        Block::timerEvent( e );
+        return;
+    }
+
+    killTimer( _progressTimer );
+    _progressTimer = 0;
+    deliverProgress();
+}
+
 void Tasklet::runnerStarted()
 {
-    _state = Running;
+    // Only an idle tasklet starts, see rearm(). A tasklet aborted before it
+    // started stays aborted, the runner ends it as soon as it checks
+    // keepRunning().
+    if( ! _state.testAndSetOrdered( NotStarted, Running ) && _state != Aborted )
+    {
+        qWarning( "Kore / The tasklet %s was started while not idle (%d)",
+                  qPrintable( objectClassName() ),
+                  static_cast< kint >( _state ) );
+    }
 
-    _waitMutex.lock();
+    _runClock.start();
+    _traceStarted = TaskletTrace::IsEnabled() ? TaskletTrace::Now() : -1;
 
-    if( this->thread() == QThread::currentThread() )
+    if( checkFlag( Headless ) )
+    {
+        emit started();
+    }
+    else if( this->thread() == QThread::currentThread() )
     {
         sendEvent( this, StartedEvent );
     }
@@ -218,76 +576,279 @@ void Tasklet::runnerStarted()
 
 void Tasklet::runnerCanceled()
 {
-    if( this->thread() == QThread::currentThread() )
+    runnerEnded( Canceled, CanceledEvent );
+}
+
+void Tasklet::runnerFailed()
+{
+    runnerEnded( Failed, FailedEvent );
+}
+
+void Tasklet::runnerCompleted()
+{
+    runnerEnded( Completed, CompletedEvent );
+}
+
+void Tasklet::runnerSkipped()
+{
+    runnerEnded( Canceled, CanceledEvent );
+}
+
+kbool Tasklet::runMemoized()
+{
+    if( ! checkFlag( Memoizable ) || TaskletCache::Capacity() == 0 )
     {
-        sendEvent( this, CanceledEvent );
+        return false;
     }
-    else
+
+    // The inputs are read before the run, it might change them.
+    const QByteArray key = TaskletCache::Key( this );
+    if( key.isEmpty() )
     {
-        _state = Canceled; // Update right away (because of the wait condition)
-        postEvent( this, Canceled );
-        _waitForFinished.wakeOne();
+        return false; // Some of its inputs can not be keyed.
     }
-    // Release the lock on the Tasklet.
-    _waitMutex.unlock();
+
+    QVariant result;
+    if( ! TaskletCache::Lookup( key, &result ) )
+    {
+        _memoKey = key;
+        return false;
+    }
+
+    runnerStarted();
+    memoizedResult( result );
+    runnerCompleted();
+    return true;
 }
 
-void Tasklet::runnerFailed()
+void Tasklet::runnerEnded( State state, kint eventType )
 {
-    if( this->thread() == QThread::currentThread() )
+    // Only complete runs are meaningful for the runner selection.
+    const TaskletRunner* runner = _runner;
+    _runner = K_NULL;
+    if( runner && state == Completed && _runClock.isValid() && metaTasklet()
+            && metaTasklet()->sampleRun( sizeHint() ) )
+    {
+        metaTasklet()->recordRun( runner, sizeHint(),
+                                  _runClock.nsecsElapsed() );
+    }
+
+    if( TaskletTrace::IsEnabled() )
+    {
+        TaskletTrace::Ended( this, runner ? runner->runnerName() : runnerName(),
+                             state, _traceSubmitted, _traceStarted );
+    }
+    _traceSubmitted = -1;
+    _traceStarted = -1;
+
+    if( ! _memoKey.isEmpty() )
+    {
+        const QVariant result = ( state == Completed )
+                ? memoizedResult()
+                : QVariant();
+        if( result.isValid() )
+        {
+            TaskletCache::Insert( _memoKey, result );
+        }
+        _memoKey.clear();
+    }
+
+    // Update right away (because of the wait condition and the observers),
+    // it is finished for the others once we let go of it.
+    const kbool autoDelete = _autoDelete;
+    _endingThread.fetchAndStoreOrdered( QThread::currentThread() );
+    _state.fetchAndStoreOrdered( state );
+
+    // Observers may unregister themselves while being notified.
+    _observersMutex.lock();
+    const QList< TaskletObserver* > observers = _observers;
+    for( kint i = 0; i < observers.size(); ++i )
+    {
+        observers.at( i )->taskletEnded( this, state );
+    }
+    _observersMutex.unlock();
+
+    // Only bother with the wait condition if somebody is actually waiting.
+    if( _waiters > 0 )
+    {
+        QMutexLocker locker( &_waitMutex );
+        _waitForFinished.wakeAll();
+    }
+
+    // An auto-deleting tasklet is disposed of by its ended notification, any
+    // other one by its waiters as soon as we let go of it: nothing may touch
+    // it afterwards.
+    if( autoDelete )
     {
-        sendEvent( this, FailedEvent );
+        _endingThread.fetchAndStoreRelease( K_NULL );
+    }
+
+    if( checkFlag( Headless ) )
+    {
+        endHeadless( state );
+    }
+    else if( this->thread() == QThread::currentThread() )
+    {
+        sendEvent( this, eventType );
     }
     else
     {
-        _state = Failed; // Update right away (because of the wait condition)
-        postEvent( this, FailedEvent );
-        _waitForFinished.wakeOne();
+        postEvent( this, eventType );
+    }
+
+    if( ! autoDelete )
+    {
+        _endingThread.fetchAndStoreRelease( K_NULL );
     }
-    // Release the lock on the Tasklet.
-    _waitMutex.unlock();
 }
 
-void Tasklet::runnerCompleted()
+void Tasklet::rearm()
 {
-    if( this->thread() == QThread::currentThread() )
+    // A finished tasklet is run again from scratch. The occurrences of a
+    // periodic timer are not fresh runs, they keep the cancellation request
+    // for the timer to stop.
+    const kint state = _state;
+    if( state >= Canceled && isFinished() )
     {
-        sendEvent( this, CompletedEvent );
+        if( _periodicTimers == 0 )
+        {
+            _cancelRequested.fetchAndStoreOrdered( 0 );
+        }
+        _state.testAndSetOrdered( state, NotStarted );
     }
-    else
+}
+
+void Tasklet::endHeadless( State state )
+{
+    // Wait for the delivery in progress, if any, the last progress always
+    // comes before the ended signal.
+    while( ! _progressDelivering.testAndSetAcquire( 0, 1 ) )
     {
-        _state = Completed; // Update right away (because of the wait condition)
-        postEvent( this, CompletedEvent );
-        _waitForFinished.wakeOne();
+        QThread::yieldCurrentThread();
+    }
+    deliverProgress();
+    _progressDelivering.fetchAndStoreRelease( 0 );
+
+    emit ended( state );
+    if( _autoDelete )
+    {
+        destroy();
     }
-    // Release the lock on the Tasklet.
-    _waitMutex.unlock();
 }
 
 void Tasklet::runnerProgress( const QString& message )
 {
-    if( this->thread() == QThread::currentThread() )
+    _progressMutex.lock();
+    _progressMessage = message;
+    _progressMutex.unlock();
+
+    if( TaskletTrace::IsEnabled() )
     {
-        ProgressEvent event( message );
-        QCoreApplication::sendEvent( this, &event );
+        TaskletTrace::Progress( this, message );
     }
-    else
+
+    notifyProgress( ProgressMessage );
+}
+
+void Tasklet::runnerProgress( kuint64 progress, kuint64 total )
+{
+    // Sequence lock: odd while a runner is writing, the 64 bits values can
+    // not be updated atomically with QAtomicInt.
+    forever
     {
-        QCoreApplication::postEvent( this, new ProgressEvent( message ) );
+        const kint sequence = _progressSequence;
+        if( ( sequence & 1 ) == 0
+                && _progressSequence.testAndSetAcquire( sequence, sequence + 1 ) )
+        {
+            break;
+        }
     }
+    _progress = progress;
+    _progressTotal = total;
+    _progressSequence.fetchAndAddRelease( 1 );
+
+    if( TaskletTrace::IsEnabled() )
+    {
+        TaskletTrace::Progress( this, progress, total );
+    }
+
+    notifyProgress( ProgressRange );
 }
 
-void Tasklet::runnerProgress( kuint64 progress, kuint64 total )
+void Tasklet::notifyProgress( kint kind )
 {
-    if( this->thread() == QThread::currentThread() )
+    kint pending;
+    do
     {
-        ProgressEvent event( progress, total );
-        QCoreApplication::sendEvent( this, &event );
+        pending = _progressPending;
     }
-    else
+    while( ! _progressPending.testAndSetOrdered( pending, pending | kind ) );
+
+    if( checkFlag( Headless ) )
+    {
+        // Whoever is delivering already, or delivers next, picks this one up.
+        if( _progressDelivering.testAndSetAcquire( 0, 1 ) )
+        {
+            if( ! _progressClock.isValid()
+                    || _progressClock.elapsed() >= _progressInterval )
+            {
+                deliverProgress();
+            }
+            _progressDelivering.fetchAndStoreRelease( 0 );
+        }
+    }
+    else if( this->thread() == QThread::currentThread() )
+    {
+        sendEvent( this, ProgressEvent );
+    }
+    else if( pending == 0 )
     {
+        // Only one progress event in flight, it delivers the latest values.
         QCoreApplication::postEvent(
                     this,
-                    new ProgressEvent( progress, total ) );
+                    new QEvent( static_cast< QEvent::Type >( ProgressEvent ) ) );
+    }
+}
+
+void Tasklet::deliverProgress()
+{
+    // Clear first, any update from now on posts a new event.
+    const kint pending = _progressPending.fetchAndStoreOrdered( 0 );
+    if( pending == 0 )
+    {
+        return;
+    }
+
+    _progressClock.start();
+
+    if( pending & ProgressMessage )
+    {
+        _progressMutex.lock();
+        const QString message = _progressMessage;
+        _progressMutex.unlock();
+
+        emit progress( message );
+    }
+
+    if( pending & ProgressRange )
+    {
+        kuint64 value;
+        kuint64 total;
+        forever
+        {
+            const kint sequence = _progressSequence.fetchAndAddAcquire( 0 );
+            if( ( sequence & 1 ) != 0 )
+            {
+                continue; // A runner is writing.
+            }
+            value = _progress;
+            total = _progressTotal;
+            if( _progressSequence.fetchAndAddOrdered( 0 ) == sequence )
+            {
+                break;
+            }
+        }
+
+        emit progress( value, total );
     }
 }
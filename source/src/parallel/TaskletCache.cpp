@@ -0,0 +1,173 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <parallel/Tasklet.hpp>
+#include <parallel/TaskletCache.hpp>
+using namespace Kore::parallel;
+using namespace Kore::data;
+
+#include <QtCore/QCache>
+#include <QtCore/QDataStream>
+#include <QtCore/QMetaProperty>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QSet>
+
+namespace {
+
+struct Cache
+{
+    Cache()
+        : results( TaskletCache::DefaultCapacity )
+        , hits( 0 )
+        , misses( 0 )
+    {
+    }
+
+    QMutex                          mutex;
+    QCache< QByteArray, QVariant >  results;    //!< Least recently used first out
+    kuint64                         hits;
+    kuint64                         misses;
+    QSet< khash >                   unkeyable;  //!< Types warned about
+};
+
+Cache& Global()
+{
+    static Cache cache;
+    return cache;
+}
+
+}
+
+void TaskletCache::Capacity( kint capacity )
+{
+    Cache& cache = Global();
+    QMutexLocker locker( &cache.mutex );
+    cache.results.setMaxCost( qMax( capacity, 0 ) );
+}
+
+kint TaskletCache::Capacity()
+{
+    Cache& cache = Global();
+    QMutexLocker locker( &cache.mutex );
+    return cache.results.maxCost();
+}
+
+TaskletCache::Statistics TaskletCache::Stats()
+{
+    Cache& cache = Global();
+    QMutexLocker locker( &cache.mutex );
+
+    Statistics stats;
+    stats.hits = cache.hits;
+    stats.misses = cache.misses;
+    stats.entries = cache.results.size();
+    stats.capacity = cache.results.maxCost();
+    stats.hitRate = ( cache.hits + cache.misses > 0 )
+            ? static_cast< kdouble >( cache.hits ) / ( cache.hits + cache.misses )
+            : 0.0;
+    return stats;
+}
+
+void TaskletCache::Clear()
+{
+    Cache& cache = Global();
+    QMutexLocker locker( &cache.mutex );
+    cache.results.clear();
+}
+
+QByteArray TaskletCache::Key( const Tasklet* tasklet )
+{
+    // The type and the stored properties, the same way KoreV1 stores them.
+    const MetaBlock* mb = tasklet->metaBlock();
+
+    QByteArray key;
+    QDataStream stream( &key, QIODevice::WriteOnly );
+    stream.setByteOrder( QDataStream::LittleEndian );
+    stream.setVersion( QDataStream::Qt_4_6 );
+
+    // From the properties of the actual tasklet type on, the name of the
+    // block is no input.
+    stream << mb->blockClassID();
+    for( kint i = Tasklet::staticMetaObject.propertyOffset();
+         i < mb->blockMetaObject()->propertyCount();
+         ++i )
+    {
+        const QMetaProperty property = mb->blockMetaObject()->property( i );
+        if( ! property.isStored() )
+        {
+            continue;
+        }
+
+        const QByteArray type( property.typeName() );
+        if( type.endsWith( '*' ) )
+        {
+            // Keyed by address, a new object at the same address would hit.
+            // Said once per type, it is run again and again.
+            Cache& cache = Global();
+            QMutexLocker locker( &cache.mutex );
+            if( ! cache.unkeyable.contains( mb->blockClassID() ) )
+            {
+                cache.unkeyable.insert( mb->blockClassID() );
+                qWarning( "Kore / The tasklet %s can not be memoized, its "
+                          "input %s is a pointer",
+                          qPrintable( mb->blockClassName() ), property.name() );
+            }
+            return QByteArray();
+        }
+
+        stream << mb->propertyID( i );
+        stream << property.read( tasklet );
+    }
+
+    return key;
+}
+
+kbool TaskletCache::Lookup( const QByteArray& key, QVariant* result )
+{
+    Cache& cache = Global();
+    QMutexLocker locker( &cache.mutex );
+
+    const QVariant* value = cache.results.object( key );
+    if( ! value )
+    {
+        ++cache.misses;
+        return false;
+    }
+
+    ++cache.hits;
+    *result = *value;
+    return true;
+}
+
+void TaskletCache::Insert( const QByteArray& key, const QVariant& result )
+{
+    Cache& cache = Global();
+    QMutexLocker locker( &cache.mutex );
+    cache.results.insert( key, new QVariant( result ) );
+}
@@ -0,0 +1,248 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <parallel/TaskletFuture.hpp>
+#include <parallel/Tasklet.hpp>
+using namespace Kore::parallel;
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QEvent>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QThread>
+
+namespace {
+
+/*
+ * Runs a continuation in the event loop of its thread.
+ */
+class Invoker : public QObject
+{
+public:
+    Invoker( TaskletFuture::SharedState* state,
+             TaskletFuture::Continuation* continuation )
+        : _state( state )
+        , _continuation( continuation )
+    {
+        _state->ref();
+        moveToThread( continuation->thread() );
+    }
+
+    virtual ~Invoker()
+    {
+        delete _continuation;
+        _state->deref();
+    }
+
+protected:
+    virtual void customEvent( QEvent* e )
+    {
+        e->accept();
+        _continuation->run( _state );
+        deleteLater();
+    }
+
+private:
+    TaskletFuture::SharedState*     _state;
+    TaskletFuture::Continuation*    _continuation;
+};
+
+}
+
+TaskletFuture::Continuation::Continuation( QThread* thread )
+    : _thread( thread )
+{
+}
+
+TaskletFuture::Continuation::~Continuation()
+{
+}
+
+TaskletFuture::SharedState::SharedState()
+    : _refs( 1 )
+    , _state( Tasklet::NotStarted )
+{
+}
+
+TaskletFuture::SharedState::~SharedState()
+{
+    qDeleteAll( _continuations );
+}
+
+void TaskletFuture::SharedState::ref()
+{
+    _refs.ref();
+}
+
+void TaskletFuture::SharedState::deref()
+{
+    if( ! _refs.deref() )
+    {
+        delete this;
+    }
+}
+
+kbool TaskletFuture::SharedState::isFinished() const
+{
+    return _state >= Tasklet::Canceled;
+}
+
+kbool TaskletFuture::SharedState::wait( kulong timeout )
+{
+    // Same scheme as Tasklet::waitForFinished.
+    if( isFinished() )
+    {
+        return true;
+    }
+
+    QMutexLocker locker( &_mutex );
+    _waiters.ref();
+    if( ! isFinished() )
+    {
+        _condition.wait( &_mutex, timeout );
+    }
+    _waiters.deref();
+
+    return isFinished();
+}
+
+void TaskletFuture::SharedState::finish( kint state )
+{
+    K_ASSERT( state >= Tasklet::Canceled )
+
+    _mutex.lock();
+    _state.fetchAndStoreOrdered( state );
+    const QList< Continuation* > continuations = _continuations;
+    _continuations.clear();
+    if( _waiters > 0 )
+    {
+        _condition.wakeAll();
+    }
+    _mutex.unlock();
+
+    for( kint i = 0; i < continuations.size(); ++i )
+    {
+        run( continuations.at( i ) );
+    }
+}
+
+void TaskletFuture::SharedState::addContinuation( Continuation* continuation )
+{
+    {
+        QMutexLocker locker( &_mutex );
+        if( ! isFinished() )
+        {
+            _continuations.append( continuation );
+            return;
+        }
+    }
+
+    run( continuation );
+}
+
+void TaskletFuture::SharedState::run( Continuation* continuation )
+{
+    if( ! continuation->thread()
+            || continuation->thread() == QThread::currentThread() )
+    {
+        // Right here, no event loop involved.
+        continuation->run( this );
+        delete continuation;
+    }
+    else
+    {
+        QCoreApplication::postEvent(
+                    new Invoker( this, continuation ),
+                    new QEvent( QEvent::User ) );
+    }
+}
+
+TaskletFuture::TaskletFuture()
+    : _state( K_NULL )
+{
+}
+
+TaskletFuture::TaskletFuture( SharedState* state )
+    : _state( state )
+{
+}
+
+TaskletFuture::TaskletFuture( const TaskletFuture& other )
+    : _state( other._state )
+{
+    if( _state )
+    {
+        _state->ref();
+    }
+}
+
+TaskletFuture::~TaskletFuture()
+{
+    if( _state )
+    {
+        _state->deref();
+    }
+}
+
+TaskletFuture& TaskletFuture::operator=( const TaskletFuture& other )
+{
+    if( other._state )
+    {
+        other._state->ref();
+    }
+    if( _state )
+    {
+        _state->deref();
+    }
+    _state = other._state;
+    return *this;
+}
+
+kbool TaskletFuture::isValid() const
+{
+    return _state != K_NULL;
+}
+
+kbool TaskletFuture::isFinished() const
+{
+    return _state && _state->isFinished();
+}
+
+kbool TaskletFuture::isCompleted() const
+{
+    return _state && _state->state() == Tasklet::Completed;
+}
+
+kint TaskletFuture::state() const
+{
+    return _state ? _state->state() : static_cast< kint >( Tasklet::NotStarted );
+}
+
+kbool TaskletFuture::waitForFinished( kulong timeout ) const
+{
+    return _state ? _state->wait( timeout ) : true;
+}
@@ -0,0 +1,300 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+namespace Kore { namespace parallel {
+
+template< typename T >
+class TaskletFutureT< T >::ValueState : public TaskletFuture::SharedState
+{
+public:
+    template< typename F >
+    inline void assign( F& continuation ) { value = continuation(); }
+    template< typename F, typename A >
+    inline void assign( F& continuation, const A& argument )
+        { value = continuation( argument ); }
+
+public:
+    T value;
+};
+
+template< typename T >
+template< class C >
+class TaskletFutureT< T >::Watcher : public TaskletObserver
+{
+public:
+    Watcher( ValueState* state, T ( C::*getter )() const )
+        : _state( state )
+        , _getter( getter )
+    {
+        _state->ref();
+    }
+
+    virtual ~Watcher()
+    {
+        _state->deref();
+    }
+
+    virtual void taskletEnded( Tasklet* tasklet, kint state )
+    {
+        // One shot.
+        tasklet->removeObserver( this );
+
+        if( state == Tasklet::Completed )
+        {
+            _state->value = ( static_cast< C* >( tasklet )->*_getter )();
+        }
+        _state->finish( state );
+
+        delete this;
+    }
+
+    virtual void taskletDestroyed( Tasklet* )
+    {
+        _state->finish( Tasklet::Canceled );
+
+        delete this;
+    }
+
+private:
+    ValueState*     _state;
+    T ( C::*_getter )() const;
+};
+
+template< typename T >
+template< typename R, typename F >
+class TaskletFutureT< T >::Then : public TaskletFuture::Continuation
+{
+public:
+    Then( typename TaskletFutureT< R >::ValueState* next, F continuation,
+          QThread* thread )
+        : Continuation( thread )
+        , _next( next )
+        , _continuation( continuation )
+    {
+        _next->ref();
+    }
+
+    virtual ~Then()
+    {
+        _next->deref();
+    }
+
+    virtual void run( TaskletFuture::SharedState* state )
+    {
+        const ValueState* source = static_cast< const ValueState* >( state );
+        if( source->state() == Tasklet::Completed )
+        {
+            _next->assign( _continuation, source->value );
+        }
+        _next->finish( source->state() );
+    }
+
+private:
+    typename TaskletFutureT< R >::ValueState*   _next;
+    F                                           _continuation;
+};
+
+template< typename T >
+TaskletFutureT< T >::TaskletFutureT()
+    : TaskletFuture()
+{
+}
+
+template< typename T >
+TaskletFutureT< T >::TaskletFutureT( ValueState* state )
+    : TaskletFuture( state )
+{
+}
+
+template< typename T >
+template< class C >
+TaskletFutureT< T > TaskletFutureT< T >::Of( C* tasklet )
+{
+    return Of( tasklet, &C::result );
+}
+
+template< typename T >
+template< class C >
+TaskletFutureT< T > TaskletFutureT< T >::Of( C* tasklet,
+                                             T ( C::*getter )() const )
+{
+    ValueState* state = new ValueState();
+    tasklet->addObserver( new Watcher< C >( state, getter ) );
+    return TaskletFutureT< T >( state );
+}
+
+template< typename T >
+T TaskletFutureT< T >::result() const
+{
+    waitForFinished();
+    return isCompleted() ? valueState()->value : T();
+}
+
+template< typename T >
+template< typename R >
+TaskletFutureT< R > TaskletFutureT< T >::then(
+        R ( *continuation )( const T& ), QThread* thread ) const
+{
+    return then< R, R ( * )( const T& ) >( continuation, thread );
+}
+
+template< typename T >
+template< typename R, typename F >
+TaskletFutureT< R > TaskletFutureT< T >::then( F continuation,
+                                               QThread* thread ) const
+{
+    K_ASSERT( isValid() )
+    typename TaskletFutureT< R >::ValueState* next =
+            new typename TaskletFutureT< R >::ValueState();
+    sharedState()->addContinuation(
+                new Then< R, F >( next, continuation, thread ) );
+    return TaskletFutureT< R >( next );
+}
+
+/*
+ * No value at all, the continuations are only run for their side effects.
+ */
+
+class TaskletFutureT< void >::ValueState : public TaskletFuture::SharedState
+{
+public:
+    template< typename F >
+    inline void assign( F& continuation ) { continuation(); }
+    template< typename F, typename A >
+    inline void assign( F& continuation, const A& argument )
+        { continuation( argument ); }
+};
+
+class TaskletFutureT< void >::Watcher : public TaskletObserver
+{
+public:
+    Watcher( ValueState* state )
+        : _state( state )
+    {
+        _state->ref();
+    }
+
+    virtual ~Watcher()
+    {
+        _state->deref();
+    }
+
+    virtual void taskletEnded( Tasklet* tasklet, kint state )
+    {
+        // One shot.
+        tasklet->removeObserver( this );
+        _state->finish( state );
+
+        delete this;
+    }
+
+    virtual void taskletDestroyed( Tasklet* )
+    {
+        _state->finish( Tasklet::Canceled );
+
+        delete this;
+    }
+
+private:
+    ValueState* _state;
+};
+
+template< typename R, typename F >
+class TaskletFutureT< void >::Then : public TaskletFuture::Continuation
+{
+public:
+    Then( typename TaskletFutureT< R >::ValueState* next, F continuation,
+          QThread* thread )
+        : Continuation( thread )
+        , _next( next )
+        , _continuation( continuation )
+    {
+        _next->ref();
+    }
+
+    virtual ~Then()
+    {
+        _next->deref();
+    }
+
+    virtual void run( TaskletFuture::SharedState* state )
+    {
+        if( state->state() == Tasklet::Completed )
+        {
+            _next->assign( _continuation );
+        }
+        _next->finish( state->state() );
+    }
+
+private:
+    typename TaskletFutureT< R >::ValueState*   _next;
+    F                                           _continuation;
+};
+
+inline TaskletFutureT< void >::TaskletFutureT()
+    : TaskletFuture()
+{
+}
+
+inline TaskletFutureT< void >::TaskletFutureT( ValueState* state )
+    : TaskletFuture( state )
+{
+}
+
+inline TaskletFutureT< void > TaskletFutureT< void >::Of( Tasklet* tasklet )
+{
+    ValueState* state = new ValueState();
+    tasklet->addObserver( new Watcher( state ) );
+    return TaskletFutureT< void >( state );
+}
+
+inline void TaskletFutureT< void >::result() const
+{
+    waitForFinished();
+}
+
+template< typename R >
+TaskletFutureT< R > TaskletFutureT< void >::then( R ( *continuation )(),
+                                                  QThread* thread ) const
+{
+    return then< R, R ( * )() >( continuation, thread );
+}
+
+template< typename R, typename F >
+TaskletFutureT< R > TaskletFutureT< void >::then( F continuation,
+                                                  QThread* thread ) const
+{
+    K_ASSERT( isValid() )
+    typename TaskletFutureT< R >::ValueState* next =
+            new typename TaskletFutureT< R >::ValueState();
+    sharedState()->addContinuation(
+                new Then< R, F >( next, continuation, thread ) );
+    return TaskletFutureT< R >( next );
+}
+
+}}
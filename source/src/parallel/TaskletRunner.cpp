@@ -27,13 +27,40 @@
  */
 
 #include <parallel/TaskletRunner.hpp>
+#include <parallel/Job.hpp>
 #include <parallel/Tasklet.hpp>
 using namespace Kore::parallel;
 
+#include <system/CPU.hpp>
+using namespace Kore::system;
+
 TaskletRunner::~TaskletRunner()
 {
 }
 
+kuint TaskletRunner::requiredFeatures() const
+{
+    return CPU::NoFeature;
+}
+
+kint TaskletRunner::maxBatchSize() const
+{
+    return 1;
+}
+
+void TaskletRunner::runBatch( const QList< Tasklet* >& tasklets ) const
+{
+    for( kint i = 0; i < tasklets.size(); ++i )
+    {
+        run( tasklets.at( i ) );
+    }
+}
+
+void TaskletRunner::runJob( Job* job ) const
+{
+    job->run();
+}
+
 void TaskletRunner::start( Tasklet* tasklet ) const
 {
     tasklet->runnerStarted();
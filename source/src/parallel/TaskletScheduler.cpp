@@ -0,0 +1,1873 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <parallel/TaskletScheduler.hpp>
+#include <parallel/Job.hpp>
+#include <parallel/Tasklet.hpp>
+#include <parallel/TaskletRunner.hpp>
+using namespace Kore::parallel;
+using namespace Kore::data;
+
+#include <KoreEngine.hpp>
+using namespace Kore;
+
+#include <system/CPU.hpp>
+using namespace Kore::system;
+
+#include <QtCore/QMutexLocker>
+#include <QtCore/QRunnable>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+
+#include <algorithm>
+
+namespace {
+
+const kint64 NoDeadline = Q_INT64_C( 0x7fffffffffffffff );
+
+// Tasks run on their submitter may submit others in turn, past that many
+// nested runs they are queued instead.
+const kint MaxInlineDepth = 8;
+_K_THREAD_LOCAL kint InlineDepth;
+
+inline kint AffinitySlot( kid key, kint slots )
+{
+    // The keys are mostly addresses, aligned: mix the higher bits in.
+    return static_cast< kint >( ( key >> 4 ) ^ ( key >> 14 ) ) & ( slots - 1 );
+}
+
+}
+
+/*
+ * Growable ring buffer of tasks. It is not thread safe: its owning Worker's
+ * mutex must be held to access it.
+ */
+class TaskletScheduler::TaskDeque
+{
+public:
+    TaskDeque()
+        : _buffer( InitialCapacity )
+        , _head( 0 )
+        , _size( 0 )
+    {
+    }
+
+    inline kint size() const { return _size; }
+
+    void pushBack( const Task& task )
+    {
+        if( _size == _buffer.size() )
+        {
+            grow();
+        }
+        _buffer[ ( _head + _size ) & ( _buffer.size() - 1 ) ] = task;
+        ++_size;
+    }
+
+    kbool popBack( Task* task )
+    {
+        if( _size == 0 )
+        {
+            return false;
+        }
+        --_size;
+        *task = _buffer.at( ( _head + _size ) & ( _buffer.size() - 1 ) );
+        return true;
+    }
+
+    kbool popFront( Task* task )
+    {
+        if( _size == 0 )
+        {
+            return false;
+        }
+        *task = _buffer.at( _head );
+        _head = ( _head + 1 ) & ( _buffer.size() - 1 );
+        --_size;
+        return true;
+    }
+
+private:
+    void grow()
+    {
+        QVector< Task > buffer( _buffer.size() << 1 );
+        for( kint i = 0; i < _size; ++i )
+        {
+            buffer[ i ] = _buffer.at( ( _head + i ) & ( _buffer.size() - 1 ) );
+        }
+        _buffer = buffer;
+        _head = 0;
+    }
+
+private:
+    enum { InitialCapacity = 64 }; // Has to be a power of 2 !
+
+    QVector< Task > _buffer;
+    kint            _head;
+    kint            _size;
+};
+
+/*
+ * Ordering of the deadline heaps, the closest deadline on top.
+ */
+struct TaskletScheduler::LaterDeadline
+{
+    inline bool operator()( const Task& t1, const Task& t2 ) const
+    {
+        return t1.deadline > t2.deadline;
+    }
+};
+
+class TaskletScheduler::Worker : public QThread
+{
+public:
+    struct Latency
+    {
+        Latency() : count( 0 ), total( 0 ), max( 0 ), missed( 0 ) {}
+        kuint64 count;
+        kuint64 total;
+        kuint64 max;
+        kuint64 missed;
+    };
+
+public:
+    Worker( TaskletScheduler* s, kint i )
+        : scheduler( s )
+        , index( i )
+        , executed( 0 )
+        , steals( 0 )
+        , affine( 0 )
+        , priority( TaskletRunner::NormalPriority )
+    {
+        setObjectName( QString( "Kore worker %1" ).arg( i ) );
+    }
+
+protected:
+    virtual void run()
+    {
+        Current = this;
+        scheduler->work( this );
+        Current = K_NULL;
+    }
+
+public:
+    TaskletScheduler* const scheduler;
+    const kint              index;
+
+    mutable QMutex          mutex;  //!< Protects all the queues.
+    TaskDeque               local[ PriorityCount ];  //!< Tasks scheduled from this worker.
+    TaskDeque               inbox[ PriorityCount ];  //!< Tasks scheduled from other threads.
+    QAtomicInt              queued; //!< In the queues above, for the affinity.
+
+    // Only written by the worker itself, approximate when read elsewhere.
+    kuint64                 executed;
+    kuint64                 steals;
+    kuint64                 affine; //!< Tasks whose key it ran last
+    Latency                 latency[ PriorityCount ];
+
+    kint                    priority;   //!< Of the task being executed.
+
+    static _K_THREAD_LOCAL Worker* Current;
+};
+
+_K_THREAD_LOCAL TaskletScheduler::Worker* TaskletScheduler::Worker::Current = K_NULL;
+
+/*
+ * A tasklet waiting in the timer wheel.
+ */
+struct TaskletScheduler::DelayedTask : public TimerWheel::Timer
+{
+    DelayedTask()
+        : id( 0 )
+        , tasklet( K_NULL )
+        , priority( TaskletRunner::NormalPriority )
+        , period( 0 )
+        , hedge( K_NULL )
+        , batch( K_NULL )
+        , generation( 0 )
+        , inFlight( false )
+    {
+    }
+
+    kint                        id;
+    Tasklet*                    tasklet;
+    TaskletRunner::Priority     priority;
+    kint                        period; //!< In ms, 0 if run once
+    TaskletScheduler::Hedge*    hedge;  //!< Launches the hedging copy instead
+    TaskletScheduler::Batch*    batch;  //!< Flushes the batch instead
+    kint                        generation; //!< Of the batch when armed
+    kbool                       inFlight; //!< Submitted and not finished yet
+};
+
+/*
+ * A due timer, submitted once the timers are unlocked.
+ */
+struct TaskletScheduler::FiredTimer
+{
+    kint                        id;
+    Tasklet*                    tasklet;
+    TaskletRunner::Priority     priority;
+    TaskletScheduler::Hedge*    hedge;
+    TaskletScheduler::Batch*    batch;
+    kint                        generation;
+};
+
+/*
+ * Submits the tasklets of the timer wheel when they are due.
+ */
+class TaskletScheduler::TimerThread : public QThread
+{
+public:
+    TimerThread( TaskletScheduler* s )
+        : scheduler( s )
+    {
+        setObjectName( "Kore timers" );
+    }
+
+protected:
+    virtual void run()
+    {
+        Current = this;
+        scheduler->runTimers();
+        Current = K_NULL;
+    }
+
+public:
+    TaskletScheduler* const scheduler;
+
+    static _K_THREAD_LOCAL TimerThread* Current;
+};
+
+_K_THREAD_LOCAL TaskletScheduler::TimerThread* TaskletScheduler::TimerThread::Current = K_NULL;
+
+/*
+ * The copies of a hedged tasklet, the first one to complete wins. The hedge
+ * is released by its timer and by each of its copies.
+ */
+struct TaskletScheduler::Hedge
+{
+    Tasklet*                    tasklet;
+    Tasklet*                    copies[ 2 ];    //!< K_NULL unless pending
+    const TaskletRunner*        runners[ 2 ];
+    TaskletRunner::Priority     priority;
+    kint                        deadline;       //!< In ms, of the second copy
+    QAtomicInt                  timer;          //!< 0 until it is added
+    QAtomicInt                  refs;
+    QMutex                      mutex;
+    kbool                       started;        //!< The tasklet started
+    kbool                       done;           //!< The tasklet ended
+    QElapsedTimer               clock;          //!< Of the first copy
+};
+
+/*
+ * Runs a copy of a hedged tasklet.
+ */
+class TaskletScheduler::HedgeTask : public QRunnable
+{
+public:
+    HedgeTask( TaskletScheduler* s, Hedge* h, kint i )
+        : scheduler( s )
+        , hedge( h )
+        , index( i )
+    {
+    }
+
+    virtual void run()
+    {
+        scheduler->runHedge( hedge, index );
+    }
+
+public:
+    TaskletScheduler* const scheduler;
+    Hedge* const hedge;
+    const kint index;
+};
+
+/*
+ * The tasklets waiting for a runner's batch to fill. A batch is never deleted
+ * before the scheduler is stopped: its generation is bumped each time it is
+ * dispatched, so that the timer armed for a previous generation is ignored.
+ */
+struct TaskletScheduler::Batch
+{
+    const TaskletRunner*        runner;
+    TaskletRunner::Priority     priority;       //!< The highest of the tasklets
+    QList< Tasklet* >           tasklets;
+    kint                        generation;
+};
+
+/*
+ * Runs a batch of tasklets.
+ */
+class TaskletScheduler::BatchTask : public QRunnable
+{
+public:
+    BatchTask( TaskletScheduler* s, const TaskletRunner* r,
+               const QList< Tasklet* >& t )
+        : scheduler( s )
+        , runner( r )
+        , tasklets( t )
+    {
+    }
+
+    virtual void run()
+    {
+        scheduler->runBatch( runner, tasklets );
+    }
+
+public:
+    TaskletScheduler* const scheduler;
+    const TaskletRunner* const runner;
+    const QList< Tasklet* > tasklets;
+};
+
+TaskletScheduler::TaskletScheduler()
+    : _workerCount( static_cast< kint >( CPU().getCPUsCount() ) )
+    , _state( NotStarted )
+    , _queueCapacity( 0 )
+    , _queuePolicy( BlockSubmitter )
+    , _queueFullCount( 0 )
+    , _rejectedCount( 0 )
+    , _nextTimer( 0 )
+    , _timerThread( K_NULL )
+    , _timersStopped( false )
+    , _batchesStopped( false )
+{
+    blockName( "Tasklet Scheduler" );
+    addFlag( SystemOwned );
+    _clock.start();
+}
+
+TaskletScheduler::~TaskletScheduler()
+{
+    stop();
+
+    if( ! checkFlag( IsBeingDeleted ) )
+    {
+        // The scheduler is a member of the engine, not an allocated Block.
+        addFlag( IsBeingDeleted );
+    }
+}
+
+kbool TaskletScheduler::schedule( Tasklet* tasklet,
+                                  const TaskletRunner* runner,
+                                  TaskletRunner::Priority priority,
+                                  kint deadline )
+{
+    Task task = { tasklet, runner, K_NULL, K_NULL,
+                  TaskletRunner::NormalPriority, NoDeadline, 0, K_NULL };
+    return submit( task, admit( 1 ), priority, deadline );
+}
+
+void TaskletScheduler::scheduleContinuation( Tasklet* tasklet,
+                                             const TaskletRunner* runner,
+                                             TaskletRunner::Priority priority )
+{
+    Task task = { tasklet, runner, K_NULL, K_NULL,
+                  TaskletRunner::NormalPriority, NoDeadline, 0, K_NULL };
+    enqueue( task, priority, -1 );
+}
+
+void TaskletScheduler::schedule( QRunnable* runnable,
+                                 TaskletRunner::Priority priority,
+                                 kint deadline )
+{
+    schedule( runnable, K_NULL, priority, deadline );
+}
+
+void TaskletScheduler::schedule( QRunnable* runnable,
+                                 const MetaTasklet* metaTasklet,
+                                 TaskletRunner::Priority priority,
+                                 kint deadline )
+{
+    Task task = { K_NULL, K_NULL, runnable, K_NULL,
+                  TaskletRunner::NormalPriority, NoDeadline, 0, metaTasklet };
+    enqueue( task, priority, deadline );
+}
+
+kbool TaskletScheduler::schedule( Job* job, const TaskletRunner* runner,
+                                  TaskletRunner::Priority priority,
+                                  kint deadline )
+{
+    Task task = { K_NULL, runner, K_NULL, job,
+                  TaskletRunner::NormalPriority, NoDeadline, 0, K_NULL };
+    if( submit( task, admit( 1 ), priority, deadline ) )
+    {
+        return true;
+    }
+
+    // Nobody else would release its counter.
+    Job::Discard( job );
+    return false;
+}
+
+kbool TaskletScheduler::schedule( const QList< Tasklet* >& tasklets,
+                                  const QList< const TaskletRunner* >& runners,
+                                  TaskletRunner::Priority priority,
+                                  kint deadline )
+{
+    K_ASSERT( tasklets.size() == runners.size() )
+    if( tasklets.isEmpty() )
+    {
+        return true;
+    }
+
+    const Admission admission = admit( tasklets.size() );
+    if( admission == Rejected )
+    {
+        return false;
+    }
+
+    QVector< Task > tasks( tasklets.size() );
+    for( kint i = 0; i < tasks.size(); ++i )
+    {
+        Task task = { tasklets.at( i ), runners.at( i ), K_NULL, K_NULL,
+                      TaskletRunner::NormalPriority, NoDeadline, 0, K_NULL };
+        tasks[ i ] = task;
+    }
+
+    if( admission == RunHere )
+    {
+        for( kint i = 0; i < tasks.size(); ++i )
+        {
+            runHere( tasks[ i ], priority, deadline );
+        }
+        return true;
+    }
+
+    enqueue( tasks, priority, deadline );
+    return true;
+}
+
+TaskletScheduler::Worker* TaskletScheduler::currentWorker() const
+{
+    Worker* worker = Worker::Current;
+    return ( worker && worker->scheduler == this ) ? worker : K_NULL;
+}
+
+TaskletScheduler::Worker* TaskletScheduler::affineWorker(
+        const Task& task ) const
+{
+    const kid key = task.tasklet ? task.tasklet->_affinityKey : 0;
+    if( key == 0 )
+    {
+        return K_NULL;
+    }
+
+    const kint last = _affinity[ AffinitySlot( key, AffinitySlots ) ] - 1;
+    if( last < 0 || last >= _workers.size() )
+    {
+        return K_NULL;
+    }
+
+    // A lagging worker would have the task stolen anyway, spread it instead.
+    Worker* worker = _workers.at( last );
+    const kint average = _pending / _workers.size();
+    return ( worker->queued <= average + AffinityImbalance ) ? worker : K_NULL;
+}
+
+TaskletScheduler::Admission TaskletScheduler::admit( kint count )
+{
+    // There is always room in empty queues, whatever the submission.
+    kint pending = _pending;
+    const kint capacity = _queueCapacity;
+    if( capacity == 0 || pending == 0 || pending + count <= capacity )
+    {
+        return Admitted;
+    }
+
+    QMutexLocker locker( &_capacityMutex );
+    ++_queueFullCount;
+
+    switch( _queuePolicy )
+    {
+    case RejectSubmission:
+        ++_rejectedCount;
+        return Rejected;
+    case RunOnCaller:
+        return RunHere;
+    default:
+        break;
+    }
+
+    if( currentWorker() )
+    {
+        // The workers drain the queues, they must not wait for room.
+        return RunHere;
+    }
+    if( TimerThread::Current )
+    {
+        // Every other timer would be late, and the timers are bounded by
+        // their count anyway.
+        return Admitted;
+    }
+
+    // The workers wake us up as they pick tasks, see nextTask().
+    _capacityWaiters.ref();
+    forever
+    {
+        pending = _pending;
+        if( _state == Stopped || _queueCapacity == 0 || pending == 0
+                || pending + count <= _queueCapacity )
+        {
+            break;
+        }
+        _capacityCondition.wait( &_capacityMutex );
+    }
+    _capacityWaiters.deref();
+
+    return Admitted;
+}
+
+kbool TaskletScheduler::submit( Task& task, Admission admission,
+                                TaskletRunner::Priority priority,
+                                kint deadline )
+{
+    switch( admission )
+    {
+    case Admitted:
+        enqueue( task, priority, deadline );
+        return true;
+    case RunHere:
+        runHere( task, priority, deadline );
+        return true;
+    default:
+        return false;
+    }
+}
+
+void TaskletScheduler::runHere( Task& task, TaskletRunner::Priority priority,
+                                kint deadline )
+{
+    if( InlineDepth >= MaxInlineDepth )
+    {
+        // The ends of the tasks run here submit again, as deep as a chain of
+        // them goes: the stack would not hold.
+        enqueue( task, priority, deadline );
+        return;
+    }
+
+    // Bound by the limit of its type as well, set aside when over it.
+    const MetaTasklet* metaTasklet = MetaTaskletOf( task );
+    if( metaTasklet && ! startRun( metaTasklet, task ) )
+    {
+        return;
+    }
+
+    ++InlineDepth;
+    execute( task );
+    --InlineDepth;
+
+    if( metaTasklet )
+    {
+        endRun( metaTasklet );
+    }
+}
+
+void TaskletScheduler::prepare( Task& task, TaskletRunner::Priority priority,
+                                kint deadline, const Worker* worker ) const
+{
+    // Parked tasks queued again keep waiting since their first submission.
+    if( task.submitted == 0 )
+    {
+        task.submitted = qMax( _clock.nsecsElapsed() / 1000, Q_INT64_C( 1 ) );
+    }
+    task.priority = ( priority < PriorityCount && priority >= 0 )
+            ? priority
+            : ( worker ? worker->priority : TaskletRunner::NormalPriority );
+    if( deadline >= 0 )
+    {
+        task.deadline = task.submitted + deadline * Q_INT64_C( 1000 );
+    }
+}
+
+void TaskletScheduler::wake( kint count )
+{
+    if( _sleeping > 0 )
+    {
+        QMutexLocker locker( &_idleMutex );
+        count = qMin( count, static_cast< kint >( _sleeping ) );
+        for( kint i = 0; i < count; ++i )
+        {
+            _idleCondition.wakeOne();
+        }
+    }
+}
+
+void TaskletScheduler::enqueue( QVector< Task >& tasks,
+                                TaskletRunner::Priority priority,
+                                kint deadline )
+{
+    if( tasks.isEmpty() )
+    {
+        return;
+    }
+
+    if( _state == NotStarted )
+    {
+        start();
+    }
+
+    Worker* worker = currentWorker();
+    kint levels[ PriorityCount ] = { 0 };
+    kint deadlines = 0;
+    kint affines = 0;
+    QVector< Worker* > targets;
+    for( kint i = 0; i < tasks.size(); ++i )
+    {
+        Task& task = tasks[ i ];
+        prepare( task, priority, deadline, worker );
+        ++levels[ task.priority ];
+        deadlines += ( task.deadline != NoDeadline ) ? 1 : 0;
+        if( task.deadline == NoDeadline && task.tasklet
+                && task.tasklet->_affinityKey != 0 )
+        {
+            targets.resize( tasks.size() );
+            ++affines;
+        }
+    }
+
+    if( _state == Stopped )
+    {
+        // Shutting down, no more workers to hand the tasks to.
+        for( kint i = 0; i < tasks.size(); ++i )
+        {
+            execute( tasks.at( i ) );
+        }
+        return;
+    }
+
+    // Account for the tasks first: no worker may go to sleep from now on.
+    _pending.fetchAndAddOrdered( tasks.size() );
+    for( kint level = 0; level < PriorityCount; ++level )
+    {
+        if( levels[ level ] > 0 )
+        {
+            _levelPending[ level ].fetchAndAddOrdered( levels[ level ] );
+        }
+    }
+
+    if( deadlines > 0 )
+    {
+        QMutexLocker locker( &_deadlinesMutex );
+        for( kint i = 0; i < tasks.size(); ++i )
+        {
+            const Task& task = tasks.at( i );
+            if( task.deadline != NoDeadline )
+            {
+                QVector< Task >& heap = _deadlines[ task.priority ];
+                heap.append( task );
+                std::push_heap( heap.begin(), heap.end(), LaterDeadline() );
+                _deadlinesPending[ task.priority ].ref();
+            }
+        }
+    }
+
+    if( affines > 0 )
+    {
+        // Once accounted for, the load of the workers is up to date.
+        affines = 0;
+        for( kint i = 0; i < tasks.size(); ++i )
+        {
+            const Task& task = tasks.at( i );
+            if( task.deadline == NoDeadline )
+            {
+                targets[ i ] = affineWorker( task );
+                affines += targets.at( i ) ? 1 : 0;
+            }
+        }
+    }
+
+    if( deadlines + affines < tasks.size() )
+    {
+        // One lock per worker: all of them in our own deque, or one slice of
+        // the batch in each inbox.
+        const kint count = worker ? 1 : _workers.size();
+        const kint slice = ( tasks.size() + count - 1 ) / count;
+        const kuint first = worker
+                ? 0
+                : static_cast< kuint >( _nextWorker.fetchAndAddRelaxed( 1 ) );
+        for( kint begin = 0, w = 0; begin < tasks.size(); begin += slice, ++w )
+        {
+            Worker* target = worker
+                    ? worker
+                    : _workers.at( ( first + w ) % _workers.size() );
+            const kint end = qMin( begin + slice, tasks.size() );
+
+            QMutexLocker locker( &target->mutex );
+            for( kint i = begin; i < end; ++i )
+            {
+                const Task& task = tasks.at( i );
+                if( task.deadline != NoDeadline
+                        || ( affines > 0 && targets.at( i ) ) )
+                {
+                    continue;
+                }
+                if( worker )
+                {
+                    target->local[ task.priority ].pushBack( task );
+                }
+                else
+                {
+                    target->inbox[ task.priority ].pushBack( task );
+                }
+                target->queued.ref();
+            }
+        }
+    }
+
+    for( kint i = 0; i < tasks.size() && affines > 0; ++i )
+    {
+        Worker* target = targets.at( i );
+        if( target )
+        {
+            push( target, tasks.at( i ), worker );
+        }
+    }
+
+    wake( tasks.size() );
+}
+
+void TaskletScheduler::push( Worker* target, const Task& task,
+                             const Worker* worker )
+{
+    QMutexLocker locker( &target->mutex );
+    if( target == worker )
+    {
+        target->local[ task.priority ].pushBack( task );
+    }
+    else
+    {
+        target->inbox[ task.priority ].pushBack( task );
+    }
+    target->queued.ref();
+}
+
+void TaskletScheduler::enqueue( Task& task, TaskletRunner::Priority priority,
+                                kint deadline )
+{
+    if( _state == NotStarted )
+    {
+        start();
+    }
+
+    Worker* worker = currentWorker();
+    prepare( task, priority, deadline, worker );
+
+    if( _state == Stopped )
+    {
+        // Shutting down, no more workers to hand the task to.
+        execute( task );
+        return;
+    }
+
+    // Account for the task first: no worker may go to sleep from now on.
+    _pending.ref();
+    _levelPending[ task.priority ].ref();
+
+    if( task.deadline != NoDeadline )
+    {
+        QMutexLocker locker( &_deadlinesMutex );
+        QVector< Task >& deadlines = _deadlines[ task.priority ];
+        deadlines.append( task );
+        std::push_heap( deadlines.begin(), deadlines.end(), LaterDeadline() );
+        _deadlinesPending[ task.priority ].ref();
+    }
+    else
+    {
+        // The worker that last ran the same data has it in its caches.
+        Worker* target = affineWorker( task );
+        if( ! target && ! worker )
+        {
+            const kuint next =
+                  static_cast< kuint >( _nextWorker.fetchAndAddRelaxed( 1 ) );
+            target = _workers.at( next % _workers.size() );
+        }
+        push( target ? target : worker, task, worker );
+    }
+
+    wake( 1 );
+}
+
+kbool TaskletScheduler::scheduleHedged( Tasklet* tasklet,
+                                        const TaskletRunner* runner,
+                                        const TaskletRunner* hedgingRunner,
+                                        kint delay,
+                                        TaskletRunner::Priority priority,
+                                        kint deadline )
+{
+    // Only worth copying once queued.
+    const Admission admission = admit( 1 );
+    Tasklet* copy = ( admission == Admitted && _state != Stopped )
+            ? tasklet->hedgedCopy()
+            : K_NULL;
+    if( ! copy )
+    {
+        Task task = { tasklet, runner, K_NULL, K_NULL,
+                      TaskletRunner::NormalPriority, NoDeadline, 0, K_NULL };
+        return submit( task, admission, priority, deadline );
+    }
+
+    // The second copy is launched from the timer thread, resolve it now.
+    const Worker* worker = currentWorker();
+    if( priority >= PriorityCount || priority < 0 )
+    {
+        priority = worker
+                ? static_cast< TaskletRunner::Priority >( worker->priority )
+                : TaskletRunner::NormalPriority;
+    }
+
+    Hedge* hedge = new Hedge;
+    hedge->tasklet = tasklet;
+    hedge->copies[ 0 ] = copy;
+    hedge->copies[ 1 ] = K_NULL;
+    hedge->runners[ 0 ] = runner;
+    hedge->runners[ 1 ] = hedgingRunner;
+    hedge->priority = priority;
+    hedge->deadline = ( deadline >= 0 ) ? qMax( deadline - delay, 0 ) : -1;
+    hedge->refs.fetchAndStoreOrdered( 2 );  // The timer and the first copy.
+    hedge->started = false;
+    hedge->done = false;
+
+    hedge->timer.fetchAndStoreOrdered(
+                addTimer( tasklet, delay, 0, priority, hedge ) );
+    schedule( new HedgeTask( this, hedge, 0 ), tasklet->metaTasklet(),
+              priority, deadline );
+    return true;
+}
+
+void TaskletScheduler::scheduleBatch( const QList< Tasklet* >& tasklets,
+                                      const TaskletRunner* runner,
+                                      TaskletRunner::Priority priority )
+{
+    if( ! tasklets.isEmpty() )
+    {
+        // A single slot of the limit of their type, see startRun().
+        schedule( new BatchTask( this, runner, tasklets ),
+                  tasklets.first()->metaTasklet(), priority, -1 );
+    }
+}
+
+kbool TaskletScheduler::scheduleBatched( Tasklet* tasklet,
+                                         const TaskletRunner* runner,
+                                         kint size, kint window,
+                                         TaskletRunner::Priority priority )
+{
+    const Admission admission = admit( 1 );
+    if( admission != Admitted || size <= 1 || window <= 0 )
+    {
+        Task task = { tasklet, runner, K_NULL, K_NULL,
+                      TaskletRunner::NormalPriority, NoDeadline, 0, K_NULL };
+        return submit( task, admission, priority, -1 );
+    }
+
+    // The batch is dispatched from the timer thread, resolve it now.
+    const Worker* worker = currentWorker();
+    if( priority >= PriorityCount || priority < 0 )
+    {
+        priority = worker
+                ? static_cast< TaskletRunner::Priority >( worker->priority )
+                : TaskletRunner::NormalPriority;
+    }
+
+    QList< Tasklet* > full;
+    DelayedTask* timer = K_NULL;
+    {
+        QMutexLocker locker( &_batchesMutex );
+        if( _batchesStopped )
+        {
+            locker.unlock();
+            Task task = { tasklet, runner, K_NULL, K_NULL,
+                          TaskletRunner::NormalPriority, NoDeadline, 0, K_NULL };
+            enqueue( task, priority, -1 );
+            return true;
+        }
+
+        Batch*& batch = _batches[ runner ];
+        if( ! batch )
+        {
+            batch = new Batch;
+            batch->runner = runner;
+            batch->generation = 0;
+        }
+
+        if( batch->tasklets.isEmpty() )
+        {
+            // The first one waits for the others, at most for the window.
+            batch->priority = priority;
+            timer = new DelayedTask;
+            timer->batch = batch;
+            timer->generation = batch->generation;
+        }
+        else
+        {
+            batch->priority = qMax( batch->priority, priority );
+        }
+        batch->tasklets.append( tasklet );
+
+        if( batch->tasklets.size() >= size )
+        {
+            full = batch->tasklets;
+            batch->tasklets.clear();
+            priority = batch->priority;
+            ++batch->generation;
+        }
+    }
+
+    // Armed with the batches unlocked, a timer armed for a batch dispatched
+    // meanwhile is ignored, see flushBatch().
+    if( timer )
+    {
+        addTimer( timer, window );
+    }
+    scheduleBatch( full, runner, priority );
+    return true;
+}
+
+kint TaskletScheduler::scheduleAfter( Tasklet* tasklet, kint delay,
+                                      TaskletRunner::Priority priority )
+{
+    return addTimer( tasklet, delay, 0, priority );
+}
+
+kint TaskletScheduler::scheduleEvery( Tasklet* tasklet, kint period,
+                                      kint delay,
+                                      TaskletRunner::Priority priority )
+{
+    K_ASSERT( ! tasklet->_autoDelete )
+    period = qMax( period, 1 );
+    return addTimer( tasklet, ( delay < 0 ) ? period : delay, period,
+                     priority );
+}
+
+kbool TaskletScheduler::cancelTimer( kint timer )
+{
+    QMutexLocker locker( &_timersMutex );
+    DelayedTask* task = _delayed.take( timer );
+    if( ! task )
+    {
+        return false;
+    }
+
+    _timers.remove( task );
+    deleteTimer( task );
+
+    // Being submitted right now, not any more once we return.
+    while( _firing.contains( timer ) && ! TimerThread::Current )
+    {
+        _firedCondition.wait( &_timersMutex );
+    }
+    return true;
+}
+
+kint TaskletScheduler::timerCount() const
+{
+    QMutexLocker locker( &_timersMutex );
+    return _delayed.size();
+}
+
+kint TaskletScheduler::workerCount() const
+{
+    return _workerCount;
+}
+
+kint TaskletScheduler::workerIndex() const
+{
+    const Worker* worker = currentWorker();
+    return worker ? worker->index : -1;
+}
+
+void TaskletScheduler::workerCount( kint count )
+{
+    QMutexLocker locker( &_stateMutex );
+    if( _state != NotStarted )
+    {
+        qWarning( "Kore / The tasklet scheduler workers are already started" );
+        return;
+    }
+    _workerCount = ( count > 0 )
+            ? count
+            : static_cast< kint >( CPU().getCPUsCount() );
+}
+
+void TaskletScheduler::queueCapacity( kint capacity )
+{
+    QMutexLocker locker( &_capacityMutex );
+    _queueCapacity = qMax( capacity, 0 );
+    _capacityCondition.wakeAll(); // There might be room now.
+}
+
+kint TaskletScheduler::queueCapacity() const
+{
+    return _queueCapacity;
+}
+
+void TaskletScheduler::queuePolicy( QueuePolicy policy )
+{
+    QMutexLocker locker( &_capacityMutex );
+    _queuePolicy = policy;
+}
+
+TaskletScheduler::QueuePolicy TaskletScheduler::queuePolicy() const
+{
+    return static_cast< QueuePolicy >( _queuePolicy );
+}
+
+kuint64 TaskletScheduler::queueFullCount() const
+{
+    QMutexLocker locker( &_capacityMutex );
+    return _queueFullCount;
+}
+
+kuint64 TaskletScheduler::rejectedCount() const
+{
+    QMutexLocker locker( &_capacityMutex );
+    return _rejectedCount;
+}
+
+kint TaskletScheduler::parkedCount() const
+{
+    QMutexLocker locker( &_parkedMutex );
+    kint parked = 0;
+    QHash< const MetaTasklet*, QList< Task > >::const_iterator it =
+            _parked.constBegin();
+    for( ; it != _parked.constEnd(); ++it )
+    {
+        parked += it.value().size();
+    }
+    return parked;
+}
+
+kint TaskletScheduler::queueDepth() const
+{
+    return _pending;
+}
+
+kint TaskletScheduler::queueDepth( kint worker ) const
+{
+    if( _state != Started || worker < 0 || worker >= _workers.size() )
+    {
+        return 0;
+    }
+    const Worker* w = _workers.at( worker );
+    QMutexLocker locker( &w->mutex );
+    kint depth = 0;
+    for( kint priority = 0; priority < PriorityCount; ++priority )
+    {
+        depth += w->local[ priority ].size() + w->inbox[ priority ].size();
+    }
+    return depth;
+}
+
+kuint64 TaskletScheduler::stealCount() const
+{
+    kuint64 steals = 0;
+    for( kint i = 0; i < _workers.size(); ++i )
+    {
+        steals += stealCount( i );
+    }
+    return steals;
+}
+
+kuint64 TaskletScheduler::stealCount( kint worker ) const
+{
+    if( _state != Started || worker < 0 || worker >= _workers.size() )
+    {
+        return 0;
+    }
+    return _workers.at( worker )->steals;
+}
+
+kuint64 TaskletScheduler::affinityCount() const
+{
+    if( _state != Started )
+    {
+        return 0;
+    }
+
+    kuint64 affine = 0;
+    for( kint i = 0; i < _workers.size(); ++i )
+    {
+        affine += _workers.at( i )->affine;
+    }
+    return affine;
+}
+
+kuint64 TaskletScheduler::executedCount( kint worker ) const
+{
+    if( _state != Started || worker < 0 || worker >= _workers.size() )
+    {
+        return 0;
+    }
+    return _workers.at( worker )->executed;
+}
+
+TaskletScheduler::LatencyStats TaskletScheduler::latencyStats(
+        TaskletRunner::Priority priority ) const
+{
+    LatencyStats stats = { 0, 0, 0, 0 };
+    if( _state != Started || priority < 0 || priority >= PriorityCount )
+    {
+        return stats;
+    }
+
+    kuint64 total = 0;
+    for( kint i = 0; i < _workers.size(); ++i )
+    {
+        const Worker::Latency& latency = _workers.at( i )->latency[ priority ];
+        stats.count += latency.count;
+        stats.maxLatency = qMax( stats.maxLatency, latency.max );
+        stats.missedDeadlines += latency.missed;
+        total += latency.total;
+    }
+    stats.averageLatency = ( stats.count > 0 ) ? total / stats.count : 0;
+    return stats;
+}
+
+void TaskletScheduler::library( Library* lib )
+{
+    Block::library( lib );
+
+    if( ! hasParent() )
+    {
+        // Removed from the engine: we are shutting down.
+        stop();
+    }
+}
+
+void TaskletScheduler::start()
+{
+    QMutexLocker locker( &_stateMutex );
+    if( _state != NotStarted )
+    {
+        return; // Somebody else was faster.
+    }
+
+    for( kint i = 0; i < _workerCount; ++i )
+    {
+        _workers.append( new Worker( this, i ) );
+    }
+
+    // Publish the workers before anyone gets to use them.
+    _state.fetchAndStoreOrdered( Started );
+
+    for( kint i = 0; i < _workers.size(); ++i )
+    {
+        _workers.at( i )->start();
+    }
+
+    qDebug( "Kore / Started the tasklet scheduler with %d workers",
+            _workerCount );
+}
+
+kint TaskletScheduler::addTimer( Tasklet* tasklet, kint delay, kint period,
+                                 TaskletRunner::Priority priority,
+                                 Hedge* hedge )
+{
+    DelayedTask* task = new DelayedTask;
+    task->tasklet = tasklet;
+    task->priority = ( priority == TaskletRunner::InheritPriority )
+            ? TaskletRunner::NormalPriority
+            : priority;
+    task->period = period;
+    task->hedge = hedge;
+    if( period > 0 && ! tasklet->_periodicTimers.fetchAndAddOrdered( 1 )
+            && tasklet->isFinished() )
+    {
+        // A fresh start, as for a run, see Tasklet::rearm().
+        tasklet->_cancelRequested.fetchAndStoreOrdered( 0 );
+    }
+    return addTimer( task, delay );
+}
+
+kint TaskletScheduler::addTimer( DelayedTask* task, kint delay )
+{
+    QMutexLocker locker( &_timersMutex );
+    task->id = ++_nextTimer;
+    _delayed.insert( task->id, task );
+    _timers.insert( task, static_cast< kuint64 >( _clock.elapsed() )
+                    + static_cast< kuint64 >( qMax( delay, 0 ) ) );
+
+    if( ! _timerThread && ! _timersStopped )
+    {
+        _timerThread = new TimerThread( this );
+        _timerThread->start();
+    }
+
+    // The new timer might be the closest one.
+    _timersCondition.wakeOne();
+
+    return task->id;
+}
+
+void TaskletScheduler::runTimers()
+{
+    QMutexLocker locker( &_timersMutex );
+
+    QList< TimerWheel::Timer* > expired;
+    QList< FiredTimer > fired;
+    while( ! _timersStopped )
+    {
+        const kuint64 now = static_cast< kuint64 >( _clock.elapsed() );
+        expired.clear();
+        _timers.advance( now, expired );
+
+        fired.clear();
+        for( kint i = 0; i < expired.size(); ++i )
+        {
+            fire( static_cast< DelayedTask* >( expired.at( i ) ), now, fired );
+        }
+
+        if( ! fired.isEmpty() )
+        {
+            // Submitted with the timers unlocked: hedged and batched tasklets
+            // add timers of their own. A canceled periodic timer waits for
+            // its submission to be over, see cancelTimer().
+            locker.unlock();
+            for( kint i = 0; i < fired.size(); ++i )
+            {
+                submit( fired.at( i ) );
+            }
+            locker.relock();
+
+            _firing.clear();
+            _firedCondition.wakeAll();
+            continue; // Time went by meanwhile.
+        }
+
+        const kuint64 next = _timers.nextTick();
+        if( _timers.size() == 0 )
+        {
+            _timersCondition.wait( &_timersMutex );
+        }
+        else if( next > now )
+        {
+            _timersCondition.wait( &_timersMutex,
+                                   static_cast< kulong >( next - now ) );
+        }
+    }
+}
+
+void TaskletScheduler::fire( DelayedTask* task, kuint64 now,
+                             QList< FiredTimer >& fired )
+{
+    const kbool canceled = task->tasklet
+            && task->tasklet->cancellationRequested();
+
+    // Never run the same tasklet twice at once: an occurrence is skipped
+    // until the previous one is finished, be it queued, batched or running.
+    // Only the first one may find the tasklet not started, a tasklet canceled
+    // before it is still submitted for it to end as canceled. A periodic
+    // tasklet canceled between two runs has ended already.
+    kbool due = true;
+    if( task->tasklet && ! task->hedge )
+    {
+        const kbool finished = task->tasklet->isFinished();
+        const Tasklet::State state = task->tasklet->state();
+        task->inFlight = task->inFlight && ! finished;
+        due = ! task->inFlight
+                && ( finished
+                     ? task->period == 0 || ! canceled
+                     : state == Tasklet::NotStarted || state == Tasklet::Aborted );
+        task->inFlight = due;
+    }
+
+    if( due )
+    {
+        const FiredTimer firing = { task->id, task->tasklet, task->priority,
+                                    task->hedge, task->batch, task->generation };
+        fired.append( firing );
+    }
+
+    if( task->period > 0 && ! canceled )
+    {
+        _firing.append( task->id );
+
+        // Fixed rate, the occurrences missed in the meantime are skipped.
+        kuint64 expires = task->expires + task->period;
+        while( expires <= now )
+        {
+            expires += task->period;
+        }
+        _timers.insert( task, expires );
+    }
+    else
+    {
+        _delayed.remove( task->id );
+        deleteTimer( task );
+    }
+}
+
+void TaskletScheduler::deleteTimer( DelayedTask* task )
+{
+    if( task->period > 0 )
+    {
+        task->tasklet->_periodicTimers.deref();
+    }
+    delete task;
+}
+
+void TaskletScheduler::submit( const FiredTimer& fired )
+{
+    if( fired.hedge )
+    {
+        launchHedge( fired.hedge );
+        return;
+    }
+
+    if( fired.batch )
+    {
+        flushBatch( fired.batch, fired.generation );
+        return;
+    }
+
+    // Due, see fire().
+    if( ! KoreEngine::RunTasklet( fired.tasklet, TaskletRunner::Asynchronous,
+                                  fired.priority ) )
+    {
+        // Rejected, it is not in flight and the next occurrence runs it.
+        QMutexLocker locker( &_timersMutex );
+        DelayedTask* task = _delayed.value( fired.id );
+        if( task )
+        {
+            task->inFlight = false;
+        }
+    }
+}
+
+void TaskletScheduler::launchHedge( Hedge* hedge )
+{
+    // Copied with the hedge locked, the tasklet may not end meanwhile.
+    const MetaTasklet* metaTasklet = K_NULL;
+    hedge->mutex.lock();
+    if( ! hedge->done )
+    {
+        hedge->copies[ 1 ] = hedge->tasklet->hedgedCopy();
+        metaTasklet = hedge->tasklet->metaTasklet();
+    }
+    const kbool launched = ( hedge->copies[ 1 ] != K_NULL );
+    if( launched )
+    {
+        hedge->refs.ref();
+    }
+    hedge->mutex.unlock();
+
+    if( launched )
+    {
+        schedule( new HedgeTask( this, hedge, 1 ), metaTasklet,
+                  hedge->priority, hedge->deadline );
+    }
+
+    releaseHedge( hedge );
+}
+
+void TaskletScheduler::runHedge( Hedge* hedge, kint index )
+{
+    Tasklet* tasklet = hedge->tasklet;
+
+    hedge->mutex.lock();
+    Tasklet* copy = hedge->copies[ index ];
+    const kbool skipped = hedge->done || tasklet->cancellationRequested();
+    if( index == 0 && ! skipped )
+    {
+        hedge->clock.start();
+    }
+    if( ! skipped && ! hedge->started )
+    {
+        // Started by whichever copy runs first, before any of them ends.
+        hedge->started = true;
+        tasklet->runnerStarted();
+    }
+    hedge->mutex.unlock();
+
+    if( ! skipped )
+    {
+        // The copy is ours, nobody needs its signals.
+        copy->headless( true );
+        if( ! copy->cancellationToken().isValid() )
+        {
+            copy->cancellationToken( tasklet->cancellationToken() );
+        }
+        copy->_runner = hedge->runners[ index ];
+        hedge->runners[ index ]->run( copy );
+    }
+
+    const Tasklet::State state = skipped ? Tasklet::Canceled : copy->state();
+    kint64 hedgedTime = -1;
+    kbool ended = false;
+
+    // The first copy to complete wins, or the last one to end.
+    hedge->mutex.lock();
+    hedge->copies[ index ] = K_NULL;
+    Tasklet* other = hedge->copies[ 1 - index ];
+    if( ! hedge->done && ( state == Tasklet::Completed || ! other ) )
+    {
+        hedge->done = ended = true;
+        if( other )
+        {
+            other->cancel(); // It stops at its next keepRunning().
+        }
+        if( index == 1 && state == Tasklet::Completed )
+        {
+            hedgedTime = hedge->clock.nsecsElapsed();
+        }
+    }
+    hedge->mutex.unlock();
+
+    if( ended )
+    {
+        // Its copies were profiled, not the tasklet itself.
+        tasklet->_runner = K_NULL;
+
+        // The first copy took at least that long, it would not be measured
+        // otherwise and the delay would shrink over time.
+        if( hedgedTime >= 0 && tasklet->metaTasklet() )
+        {
+            tasklet->metaTasklet()->recordLatency(
+                        tasklet->sizeHint(),
+                        static_cast< kuint64 >( hedgedTime ) );
+        }
+
+        if( skipped )
+        {
+            tasklet->runnerSkipped();
+        }
+        else if( state == Tasklet::Completed
+                 && ! tasklet->cancellationRequested() )
+        {
+            tasklet->hedgedResult( copy );
+            tasklet->runnerCompleted();
+        }
+        else if( state == Tasklet::Failed )
+        {
+            tasklet->runnerFailed();
+        }
+        else
+        {
+            tasklet->runnerCanceled();
+        }
+
+        // Fired already otherwise, the hedge was released by its timer.
+        const kint timer = hedge->timer;
+        if( timer != 0 && cancelTimer( timer ) )
+        {
+            releaseHedge( hedge );
+        }
+    }
+
+    delete copy;
+    releaseHedge( hedge );
+}
+
+void TaskletScheduler::releaseHedge( Hedge* hedge )
+{
+    if( ! hedge->refs.deref() )
+    {
+        delete hedge;
+    }
+}
+
+void TaskletScheduler::flushBatch( Batch* batch, kint generation )
+{
+    QList< Tasklet* > tasklets;
+    TaskletRunner::Priority priority;
+    {
+        QMutexLocker locker( &_batchesMutex );
+        if( batch->generation != generation )
+        {
+            return; // Dispatched once full already.
+        }
+        tasklets = batch->tasklets;
+        batch->tasklets.clear();
+        priority = batch->priority;
+        ++batch->generation;
+    }
+
+    scheduleBatch( tasklets, batch->runner, priority );
+}
+
+void TaskletScheduler::runBatch( const TaskletRunner* runner,
+                                 const QList< Tasklet* >& tasklets )
+{
+    // The tasklets canceled while waiting end without ever running.
+    QList< Tasklet* > running;
+    running.reserve( tasklets.size() );
+    for( kint i = 0; i < tasklets.size(); ++i )
+    {
+        Tasklet* tasklet = tasklets.at( i );
+        if( tasklet->cancellationRequested() )
+        {
+            tasklet->runnerSkipped();
+        }
+        else
+        {
+            running.append( tasklet );
+        }
+    }
+
+    if( ! running.isEmpty() )
+    {
+        runner->runBatch( running );
+    }
+}
+
+void TaskletScheduler::stop()
+{
+    // The timers first, they submit tasklets.
+    _timersMutex.lock();
+    _timersStopped = true;
+    _timersCondition.wakeAll();
+    TimerThread* timerThread = _timerThread;
+    _timerThread = K_NULL;
+    _timersMutex.unlock();
+
+    if( timerThread )
+    {
+        timerThread->wait();
+        delete timerThread;
+    }
+
+    QList< Hedge* > hedges;
+    _timersMutex.lock();
+    QHash< kint, DelayedTask* >::const_iterator it = _delayed.constBegin();
+    for( ; it != _delayed.constEnd(); ++it )
+    {
+        _timers.remove( it.value() );
+        if( it.value()->hedge )
+        {
+            hedges.append( it.value()->hedge );
+        }
+    }
+    for( it = _delayed.constBegin(); it != _delayed.constEnd(); ++it )
+    {
+        deleteTimer( it.value() );
+    }
+    _delayed.clear();
+    _timersMutex.unlock();
+
+    // Never launched, their first copy ends the hedged tasklets.
+    for( kint i = 0; i < hedges.size(); ++i )
+    {
+        releaseHedge( hedges.at( i ) );
+    }
+
+    // Their timers are gone, the pending batches are dispatched right away.
+    _batchesMutex.lock();
+    _batchesStopped = true;
+    const QList< Batch* > batches = _batches.values();
+    _batches.clear();
+    _batchesMutex.unlock();
+
+    for( kint i = 0; i < batches.size(); ++i )
+    {
+        Batch* batch = batches.at( i );
+        scheduleBatch( batch->tasklets, batch->runner, batch->priority );
+        delete batch;
+    }
+
+    QMutexLocker locker( &_stateMutex );
+    if( _state.fetchAndStoreOrdered( Stopped ) != Started )
+    {
+        return; // No workers to wait for.
+    }
+
+    // The blocked submitters run their tasks themselves from now on.
+    _capacityMutex.lock();
+    _capacityCondition.wakeAll();
+    _capacityMutex.unlock();
+
+    // Wake everybody up, the workers leave once all the queues are drained.
+    _idleMutex.lock();
+    _idleCondition.wakeAll();
+    _idleMutex.unlock();
+
+    for( kint i = 0; i < _workers.size(); ++i )
+    {
+        _workers.at( i )->wait();
+    }
+
+    qDebug( "Kore / Stopped the tasklet scheduler (%llu tasks stolen)",
+            stealCount() );
+
+    qDeleteAll( _workers );
+    _workers.clear();
+}
+
+void TaskletScheduler::work( Worker* worker )
+{
+    Task task;
+    forever
+    {
+        if( nextTask( worker, &task ) )
+        {
+            // Resolved first, an auto-deleting tasklet is gone once run.
+            const MetaTasklet* metaTasklet = MetaTaskletOf( task );
+            if( metaTasklet && ! startRun( metaTasklet, task ) )
+            {
+                continue; // Over the limit of its type, set aside.
+            }
+
+            const kint64 now = _clock.nsecsElapsed() / 1000;
+            Worker::Latency& latency = worker->latency[ task.priority ];
+            const kuint64 waited = static_cast< kuint64 >( now - task.submitted );
+            ++latency.count;
+            latency.total += waited;
+            latency.max = qMax( latency.max, waited );
+            if( now > task.deadline )
+            {
+                ++latency.missed;
+            }
+
+            if( task.tasklet && task.tasklet->_affinityKey != 0 )
+            {
+                // We have its data in our caches from now on.
+                QAtomicInt& last = _affinity[
+                        AffinitySlot( task.tasklet->_affinityKey,
+                                      AffinitySlots ) ];
+                if( last.fetchAndStoreRelaxed( worker->index + 1 )
+                        == worker->index + 1 )
+                {
+                    ++worker->affine;
+                }
+            }
+
+            worker->priority = task.priority;
+            execute( task );
+            ++worker->executed;
+
+            if( metaTasklet )
+            {
+                endRun( metaTasklet );
+            }
+            continue;
+        }
+
+        QMutexLocker locker( &_idleMutex );
+        _sleeping.ref();
+
+        // Pending tasks might be in the middle of being queued, or in a queue
+        // that was locked when we tried to steal from it.
+        const kbool idle = ( _pending == 0 );
+        if( idle && _state == Stopped )
+        {
+            _sleeping.deref();
+            return;
+        }
+        if( idle )
+        {
+            _idleCondition.wait( &_idleMutex );
+        }
+
+        _sleeping.deref();
+        locker.unlock();
+
+        if( ! idle )
+        {
+            QThread::yieldCurrentThread();
+        }
+    }
+}
+
+const MetaTasklet* TaskletScheduler::MetaTaskletOf( const Task& task )
+{
+    // The batches and the hedged copies count against the limit of the type
+    // of their tasklets, a batch as a single run.
+    return task.tasklet ? task.tasklet->metaTasklet() : task.metaTasklet;
+}
+
+kbool TaskletScheduler::startRun( const MetaTasklet* metaTasklet,
+                                  const Task& task )
+{
+    forever
+    {
+        const kint inFlight = metaTasklet->_inFlight;
+        const kint limit = metaTasklet->_maxConcurrency;
+        if( limit > 0 && inFlight >= limit )
+        {
+            break;
+        }
+        if( metaTasklet->_inFlight.testAndSetOrdered( inFlight, inFlight + 1 ) )
+        {
+            return true;
+        }
+    }
+
+    // Checked again with the tasklets set aside locked: the one ending in the
+    // meantime either left a slot or will queue this one again, see endRun().
+    QMutexLocker locker( &_parkedMutex );
+    const kint limit = metaTasklet->_maxConcurrency;
+    if( limit == 0 || metaTasklet->_inFlight < limit )
+    {
+        metaTasklet->_inFlight.ref();
+        return true;
+    }
+    _parked[ metaTasklet ].append( task );
+    return false;
+}
+
+void TaskletScheduler::endRun( const MetaTasklet* metaTasklet )
+{
+    QList< Task > tasks;
+    {
+        QMutexLocker locker( &_parkedMutex );
+        metaTasklet->_inFlight.deref();
+
+        QHash< const MetaTasklet*, QList< Task > >::iterator it =
+                _parked.find( metaTasklet );
+        if( it == _parked.end() )
+        {
+            return;
+        }
+
+        // As many as there are free slots, the limit might have been raised.
+        const kint limit = metaTasklet->_maxConcurrency;
+        kint count = ( limit == 0 )
+                ? it.value().size()
+                : limit - metaTasklet->_inFlight;
+        for( ; count > 0 && ! it.value().isEmpty(); --count )
+        {
+            tasks.append( it.value().takeFirst() );
+        }
+        if( it.value().isEmpty() )
+        {
+            _parked.erase( it );
+        }
+    }
+
+    // Queued again with their priority, deadline and submission time.
+    for( kint i = 0; i < tasks.size(); ++i )
+    {
+        Task task = tasks.at( i );
+        enqueue( task, static_cast< TaskletRunner::Priority >( task.priority ),
+                 -1 );
+    }
+}
+
+void TaskletScheduler::execute( const Task& task )
+{
+    if( task.runnable )
+    {
+        task.runnable->run();
+        if( task.runnable->autoDelete() )
+        {
+            delete task.runnable;
+        }
+    }
+    else if( task.job )
+    {
+        Job::Execute( task.job, task.runner );
+    }
+    else if( task.tasklet->cancellationRequested() )
+    {
+        // Canceled while queued, it ends without ever running.
+        task.tasklet->runnerSkipped();
+    }
+    else
+    {
+        task.runner->run( task.tasklet );
+    }
+}
+
+kbool TaskletScheduler::nextTask( Worker* worker, Task* task )
+{
+    // Strict priorities, only look at the levels that have pending tasks.
+    for( kint priority = PriorityCount - 1; priority >= 0; --priority )
+    {
+        if( _levelPending[ priority ] != 0
+                && nextTask( worker, priority, task ) )
+        {
+            _levelPending[ priority ].deref();
+            _pending.deref();
+            if( _capacityWaiters > 0 )
+            {
+                // Room for the blocked submitters.
+                QMutexLocker locker( &_capacityMutex );
+                _capacityCondition.wakeAll();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+kbool TaskletScheduler::nextTask( Worker* worker, kint priority, Task* task )
+{
+    // The closest deadline first.
+    if( _deadlinesPending[ priority ] != 0 )
+    {
+        QMutexLocker locker( &_deadlinesMutex );
+        QVector< Task >& deadlines = _deadlines[ priority ];
+        if( ! deadlines.isEmpty() )
+        {
+            std::pop_heap( deadlines.begin(), deadlines.end(),
+                           LaterDeadline() );
+            *task = deadlines.last();
+            deadlines.remove( deadlines.size() - 1 );
+            _deadlinesPending[ priority ].deref();
+            return true;
+        }
+    }
+
+    // Our own tasks then: the most recent local one, or the oldest external.
+    {
+        QMutexLocker locker( &worker->mutex );
+        if( worker->local[ priority ].popBack( task )
+                || worker->inbox[ priority ].popFront( task ) )
+        {
+            worker->queued.deref();
+            return true;
+        }
+    }
+
+    // Then steal the oldest task from the other workers, without waiting on
+    // a contended queue.
+    const kint count = _workers.size();
+    for( kint i = 1; i < count && _levelPending[ priority ] != 0; ++i )
+    {
+        Worker* victim = _workers.at( ( worker->index + i ) % count );
+        if( ! victim->mutex.tryLock() )
+        {
+            continue;
+        }
+        const kbool stolen = victim->inbox[ priority ].popFront( task )
+                || victim->local[ priority ].popFront( task );
+        if( stolen )
+        {
+            victim->queued.deref();
+        }
+        victim->mutex.unlock();
+
+        if( stolen )
+        {
+            ++worker->steals;
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,366 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <parallel/Tasklet.hpp>
+#include <parallel/TaskletRunner.hpp>
+#include <parallel/TaskletTrace.hpp>
+using namespace Kore::parallel;
+
+#include <QtCore/QByteArray>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QThread>
+
+namespace {
+
+// Written to the file once a thread buffered that much.
+const kint FlushSize = 64 * 1024;
+
+const char* const StateNames[] =
+{
+    "NotStarted", "Running", "Aborted", "Canceled", "Failed", "Completed"
+};
+
+/*
+ * Events of a single thread. Only its thread appends to it, the mutex is
+ * only contended when the trace is flushed.
+ */
+struct Buffer
+{
+    QMutex      mutex;
+    QByteArray  data;
+    kint        tid;
+    QString     threadName;
+};
+
+/*
+ * The trace file and all the buffers ever created. The buffers are kept for
+ * the lifetime of the process since the threads hold on to them.
+ */
+struct Trace
+{
+    Trace() : file( K_NULL ), pid( 0 ) {}
+
+    QMutex              mutex;  //!< Protects the buffers list and the file.
+    QList< Buffer* >    buffers;
+    QFile*              file;
+    qint64              pid;
+    QElapsedTimer       clock;  //!< Never restarted, the tasklets keep stamps.
+};
+
+Trace& Global()
+{
+    static Trace trace;
+    return trace;
+}
+
+_K_THREAD_LOCAL Buffer* LocalBuffer = K_NULL;
+
+void appendString( QByteArray& data, const QString& string )
+{
+    data.append( '"' );
+    const QByteArray utf8 = string.toUtf8();
+    for( kint i = 0; i < utf8.size(); ++i )
+    {
+        const char c = utf8.at( i );
+        switch( c )
+        {
+        case '"':
+            data.append( "\\\"" );
+            break;
+        case '\\':
+            data.append( "\\\\" );
+            break;
+        case '\n':
+            data.append( "\\n" );
+            break;
+        case '\t':
+            data.append( "\\t" );
+            break;
+        default:
+            if( static_cast< unsigned char >( c ) < 0x20 )
+            {
+                data.append( ' ' );
+            }
+            else
+            {
+                data.append( c );
+            }
+            break;
+        }
+    }
+    data.append( '"' );
+}
+
+// Starts an event object, the caller appends its arguments and closes it.
+void appendHeader( QByteArray& data, const char* phase, const char* category,
+                   const QString& name, kint64 timestamp, kint tid )
+{
+    data.append( "{\"name\":" );
+    appendString( data, name );
+    data.append( ",\"cat\":\"" );
+    data.append( category );
+    data.append( "\",\"ph\":\"" );
+    data.append( phase );
+    data.append( "\",\"ts\":" );
+    data.append( QByteArray::number( timestamp ) );
+    data.append( ",\"pid\":" );
+    data.append( QByteArray::number( Global().pid ) );
+    data.append( ",\"tid\":" );
+    data.append( QByteArray::number( tid ) );
+}
+
+void appendThreadName( Buffer* buffer )
+{
+    buffer->data.append( "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" );
+    buffer->data.append( QByteArray::number( Global().pid ) );
+    buffer->data.append( ",\"tid\":" );
+    buffer->data.append( QByteArray::number( buffer->tid ) );
+    buffer->data.append( ",\"args\":{\"name\":" );
+    appendString( buffer->data, buffer->threadName );
+    buffer->data.append( "}},\n" );
+}
+
+// Must be called with the trace locked.
+void write( Buffer* buffer )
+{
+    Trace& trace = Global();
+    if( trace.file && ! buffer->data.isEmpty() )
+    {
+        trace.file->write( buffer->data );
+    }
+    buffer->data.clear();
+}
+
+Buffer* localBuffer()
+{
+    if( LocalBuffer )
+    {
+        return LocalBuffer;
+    }
+
+    QThread* thread = QThread::currentThread();
+    Buffer* buffer = new Buffer;
+    buffer->threadName = thread->objectName();
+    if( buffer->threadName.isEmpty() )
+    {
+        buffer->threadName = ( QCoreApplication::instance()
+                               && QCoreApplication::instance()->thread() == thread )
+                ? QString( "Main thread" )
+                : QString( "Thread %1" ).arg( quintptr( thread ), 0, 16 );
+    }
+
+    Trace& trace = Global();
+    QMutexLocker locker( &trace.mutex );
+    buffer->tid = trace.buffers.size() + 1;
+    appendThreadName( buffer );
+    trace.buffers.append( buffer );
+
+    LocalBuffer = buffer;
+    return buffer;
+}
+
+// Hands the events over to the file once the buffer is large enough.
+void release( Buffer* buffer )
+{
+    const kbool flush = buffer->data.size() >= FlushSize;
+    buffer->mutex.unlock();
+
+    if( flush )
+    {
+        Trace& trace = Global();
+        QMutexLocker locker( &trace.mutex );
+        QMutexLocker bufferLocker( &buffer->mutex );
+        write( buffer );
+    }
+}
+
+}
+
+QAtomicInt TaskletTrace::_Enabled;
+
+kbool TaskletTrace::Start( const QString& fileName )
+{
+    Stop();
+
+    Trace& trace = Global();
+    QMutexLocker locker( &trace.mutex );
+
+    QFile* file = new QFile( fileName );
+    if( ! file->open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+    {
+        qWarning( "Kore / Could not open the trace file %s",
+                  qPrintable( fileName ) );
+        delete file;
+        return false;
+    }
+
+    trace.file = file;
+    trace.pid = QCoreApplication::applicationPid();
+    if( ! trace.clock.isValid() )
+    {
+        trace.clock.start();
+    }
+
+    trace.file->write( "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+
+    // Drop whatever was recorded after the previous trace was stopped.
+    for( kint i = 0; i < trace.buffers.size(); ++i )
+    {
+        Buffer* buffer = trace.buffers.at( i );
+        QMutexLocker bufferLocker( &buffer->mutex );
+        buffer->data.clear();
+        appendThreadName( buffer );
+    }
+
+    _Enabled.fetchAndStoreOrdered( 1 );
+    return true;
+}
+
+void TaskletTrace::Stop()
+{
+    Trace& trace = Global();
+    QMutexLocker locker( &trace.mutex );
+
+    if( _Enabled.fetchAndStoreOrdered( 0 ) == 0 )
+    {
+        return;
+    }
+
+    for( kint i = 0; i < trace.buffers.size(); ++i )
+    {
+        Buffer* buffer = trace.buffers.at( i );
+        QMutexLocker bufferLocker( &buffer->mutex );
+        write( buffer );
+        buffer->data.squeeze();
+    }
+
+    // The last event closes the list, every other one ends with a comma.
+    QByteArray data( "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" );
+    data.append( QByteArray::number( trace.pid ) );
+    data.append( ",\"args\":{\"name\":" );
+    appendString( data, QCoreApplication::applicationName().isEmpty()
+                  ? QString( "Kore" )
+                  : QCoreApplication::applicationName() );
+    data.append( "}}\n]}\n" );
+    trace.file->write( data );
+
+    trace.file->close();
+    delete trace.file;
+    trace.file = K_NULL;
+}
+
+kint64 TaskletTrace::Now()
+{
+    // Microseconds, the unit of the trace event format.
+    return Global().clock.nsecsElapsed() / 1000;
+}
+
+void TaskletTrace::Submitted( const Tasklet* tasklet,
+                              const TaskletRunner* runner )
+{
+    Buffer* buffer = localBuffer();
+    buffer->mutex.lock();
+    appendHeader( buffer->data, "i", "submit", tasklet->objectClassName(),
+                  Now(), buffer->tid );
+    buffer->data.append( ",\"s\":\"t\",\"args\":{\"runner\":" );
+    appendString( buffer->data, runner->runnerName() );
+    buffer->data.append( "}},\n" );
+    release( buffer );
+}
+
+void TaskletTrace::Ended( const Tasklet* tasklet, const QString& runner,
+                          kint state, kint64 submitted, kint64 started )
+{
+    const kint64 now = Now();
+
+    Buffer* buffer = localBuffer();
+    buffer->mutex.lock();
+    if( started < 0 )
+    {
+        // Skipped before it ever started.
+        appendHeader( buffer->data, "i", "tasklet",
+                      tasklet->objectClassName(), now, buffer->tid );
+        buffer->data.append( ",\"s\":\"t\"" );
+    }
+    else
+    {
+        appendHeader( buffer->data, "X", "tasklet",
+                      tasklet->objectClassName(), started, buffer->tid );
+        buffer->data.append( ",\"dur\":" );
+        buffer->data.append( QByteArray::number( now - started ) );
+    }
+    buffer->data.append( ",\"args\":{\"runner\":" );
+    appendString( buffer->data, runner );
+    buffer->data.append( ",\"state\":\"" );
+    buffer->data.append( StateNames[ state ] );
+    buffer->data.append( '"' );
+    if( submitted >= 0 && started >= submitted )
+    {
+        buffer->data.append( ",\"queue_wait_us\":" );
+        buffer->data.append( QByteArray::number( started - submitted ) );
+    }
+    if( started >= 0 )
+    {
+        buffer->data.append( ",\"run_us\":" );
+        buffer->data.append( QByteArray::number( now - started ) );
+    }
+    buffer->data.append( "}},\n" );
+    release( buffer );
+}
+
+void TaskletTrace::Progress( const Tasklet* tasklet, kuint64 progress,
+                             kuint64 total )
+{
+    Buffer* buffer = localBuffer();
+    buffer->mutex.lock();
+    appendHeader( buffer->data, "i", "progress", tasklet->objectClassName(),
+                  Now(), buffer->tid );
+    buffer->data.append( ",\"s\":\"t\",\"args\":{\"progress\":" );
+    buffer->data.append( QByteArray::number( progress ) );
+    buffer->data.append( ",\"total\":" );
+    buffer->data.append( QByteArray::number( total ) );
+    buffer->data.append( "}},\n" );
+    release( buffer );
+}
+
+void TaskletTrace::Progress( const Tasklet* tasklet, const QString& message )
+{
+    Buffer* buffer = localBuffer();
+    buffer->mutex.lock();
+    appendHeader( buffer->data, "i", "progress", tasklet->objectClassName(),
+                  Now(), buffer->tid );
+    buffer->data.append( ",\"s\":\"t\",\"args\":{\"message\":" );
+    appendString( buffer->data, message );
+    buffer->data.append( "}},\n" );
+    release( buffer );
+}
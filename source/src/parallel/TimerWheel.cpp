@@ -0,0 +1,228 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <parallel/TimerWheel.hpp>
+using namespace Kore::parallel;
+
+namespace {
+
+const kuint64 SlotMask = TimerWheel::Slots - 1;
+const kuint64 MaxTick = Q_UINT64_C( 0xffffffffffffffff );
+
+// Number of ticks covered by a level and all the ones below it.
+inline kuint64 Span( kint level )
+{
+    return Q_UINT64_C( 1 ) << ( TimerWheel::SlotBits * ( level + 1 ) );
+}
+
+inline kuint64 SlotOf( kuint64 tick, kint level )
+{
+    return ( tick >> ( TimerWheel::SlotBits * level ) ) & SlotMask;
+}
+
+}
+
+TimerWheel::Timer::Timer()
+    : expires( 0 )
+    , previous( K_NULL )
+    , next( K_NULL )
+    , level( -1 )
+    , slot( -1 )
+{
+}
+
+TimerWheel::TimerWheel( kuint64 now )
+    : _now( now )
+    , _size( 0 )
+{
+    for( kint level = 0; level < Levels; ++level )
+    {
+        for( kint slot = 0; slot < Slots; ++slot )
+        {
+            _slots[ level ][ slot ] = K_NULL;
+        }
+        _occupied[ level ] = 0;
+    }
+}
+
+void TimerWheel::insert( Timer* timer, kuint64 expires )
+{
+    K_ASSERT( timer->level < 0 )
+    timer->expires = qMax( expires, _now + 1 );
+    place( timer );
+    ++_size;
+}
+
+void TimerWheel::remove( Timer* timer )
+{
+    K_ASSERT( timer->level >= 0 )
+    unlink( timer );
+    --_size;
+}
+
+void TimerWheel::advance( kuint64 now, QList< Timer* >& expired )
+{
+    while( _now < now )
+    {
+        if( _size == 0 )
+        {
+            _now = now;
+            return;
+        }
+
+        if( _occupied[ 0 ] == 0 )
+        {
+            // Nothing expires before the next cascade, skip right to it.
+            const kuint64 boundary = ( ( _now >> SlotBits ) + 1 ) << SlotBits;
+            _now = qMin( boundary, now );
+        }
+        else
+        {
+            ++_now;
+        }
+
+        // Cascade the upper levels down, starting from the highest one so that
+        // its timers get spread over the lower levels before they are cascaded.
+        kint levels = 0;
+        while( levels + 1 < Levels && SlotOf( _now, levels ) == 0 )
+        {
+            ++levels;
+        }
+        for( kint level = levels; level > 0; --level )
+        {
+            cascade( level );
+        }
+
+        const kint slot = static_cast< kint >( SlotOf( _now, 0 ) );
+        while( _slots[ 0 ][ slot ] )
+        {
+            Timer* timer = _slots[ 0 ][ slot ];
+            unlink( timer );
+            --_size;
+            expired.append( timer );
+        }
+    }
+}
+
+kuint64 TimerWheel::nextTick() const
+{
+    if( _size == 0 )
+    {
+        return MaxTick;
+    }
+
+    // Upper levels have to be cascaded on the next wrap of the first level.
+    kuint64 next = MaxTick;
+    for( kint level = Levels - 1; level > 0; --level )
+    {
+        if( _occupied[ level ] != 0 )
+        {
+            const kint shift = SlotBits * level;
+            next = ( ( _now >> shift ) + 1 ) << shift;
+        }
+    }
+
+    if( _occupied[ 0 ] != 0 )
+    {
+        for( kuint64 tick = _now + 1; tick <= _now + Slots; ++tick )
+        {
+            if( _occupied[ 0 ] & ( Q_UINT64_C( 1 ) << SlotOf( tick, 0 ) ) )
+            {
+                return qMin( tick, next );
+            }
+        }
+    }
+
+    return next;
+}
+
+void TimerWheel::place( Timer* timer )
+{
+    // Past the range of the wheel, parked in the farthest slot.
+    const kuint64 delta = ( timer->expires > _now )
+            ? qMin( timer->expires - _now, Span( Levels - 1 ) - 1 )
+            : 0;
+
+    kint level = 0;
+    while( level + 1 < Levels && delta >= Span( level ) )
+    {
+        ++level;
+    }
+
+    const kint slot = static_cast< kint >( SlotOf( _now + delta, level ) );
+    timer->level = level;
+    timer->slot = slot;
+    timer->previous = K_NULL;
+    timer->next = _slots[ level ][ slot ];
+    if( timer->next )
+    {
+        timer->next->previous = timer;
+    }
+    _slots[ level ][ slot ] = timer;
+    _occupied[ level ] |= Q_UINT64_C( 1 ) << slot;
+}
+
+void TimerWheel::cascade( kint level )
+{
+    const kint slot = static_cast< kint >( SlotOf( _now, level ) );
+    Timer* timer = _slots[ level ][ slot ];
+    _slots[ level ][ slot ] = K_NULL;
+    _occupied[ level ] &= ~( Q_UINT64_C( 1 ) << slot );
+
+    while( timer )
+    {
+        Timer* next = timer->next;
+        place( timer );
+        timer = next;
+    }
+}
+
+void TimerWheel::unlink( Timer* timer )
+{
+    if( timer->previous )
+    {
+        timer->previous->next = timer->next;
+    }
+    else
+    {
+        _slots[ timer->level ][ timer->slot ] = timer->next;
+        if( ! timer->next )
+        {
+            _occupied[ timer->level ] &= ~( Q_UINT64_C( 1 ) << timer->slot );
+        }
+    }
+    if( timer->next )
+    {
+        timer->next->previous = timer->previous;
+    }
+
+    timer->previous = K_NULL;
+    timer->next = K_NULL;
+    timer->level = -1;
+    timer->slot = -1;
+}
@@ -36,12 +36,26 @@ using namespace Kore::system;
 #define SSE3_SUPPORTED          0x00000001
 #define SSE3_EX_SUPPORTED       0x00000200
 #define SSE4_SUPPORTED          0x00080000
+#define SSE42_SUPPORTED         0x00100000
+#define OSXSAVE_SUPPORTED       0x08000000
+#define AVX_SUPPORTED           0x10000000
 #define AMD_3DNOW_SUPPORTED     0x80000000
 
+// bit flags set by cpuid in ebx when called with eax set to 7 and ecx to 0
+#define AVX2_SUPPORTED          0x00000020
+#define AVX512F_SUPPORTED       0x00010000
+
+// register states the OS saves on context switches (XCR0)
+#define XCR0_AVX_STATE          0x00000006
+#define XCR0_AVX512_STATE       0x000000E6
+
 // AMD specific
 #define AMD_3DNOW_EX_SUPPORTED  0x40000000
 #define AMD_MMX_EX_SUPPORTED    0x00400000
 
+#include <QtCore/QThread>
+
+#include <cpuid.h>
 #include <cstring>
 using namespace std;
 
@@ -56,6 +70,9 @@ CPU::~CPU()
 
 void CPU::init()
 {
+    // Logical processors count (Qt knows how to ask the OS for that one).
+    _cpusCount = K_MAX( QThread::idealThreadCount(), 1 );
+
     // Get the parameters.
     unsigned int cpu_info = 0;
     unsigned int cpu_ssex = 0;
@@ -73,8 +90,36 @@ void CPU::init()
     _SSE2 =	cpu_info & SSE2_SUPPORTED;
     _SSE3 = cpu_ssex & SSE3_SUPPORTED;
     _SSE4 = cpu_ssex & SSE4_SUPPORTED;
+    _SSE42 = cpu_ssex & SSE42_SUPPORTED;
     _3DNow = cpu_info & AMD_3DNOW_SUPPORTED;
 
+    // The AVX registers are only usable if the OS saves them.
+    unsigned int xcr0 = 0;
+    if( cpu_ssex & OSXSAVE_SUPPORTED )
+    {
+        unsigned int xcr0_high = 0;
+        asm volatile(
+            "xgetbv"
+            : "=a" ( xcr0 ), "=d" ( xcr0_high )
+            : "c" ( 0 )
+        );
+    }
+
+    _AVX = ( cpu_ssex & AVX_SUPPORTED )
+            && ( xcr0 & XCR0_AVX_STATE ) == XCR0_AVX_STATE;
+    _AVX2 = false;
+    _AVX512 = false;
+
+    if( __get_cpuid_max( 0, K_NULL ) >= 7 )
+    {
+        unsigned int eax, ebx, ecx, edx;
+        __cpuid_count( 7, 0, eax, ebx, ecx, edx );
+
+        _AVX2 = _AVX && ( ebx & AVX2_SUPPORTED );
+        _AVX512 = ( ebx & AVX512F_SUPPORTED )
+                && ( xcr0 & XCR0_AVX512_STATE ) == XCR0_AVX512_STATE;
+    }
+
     // Vendor string.
     unsigned int temp[ 3 ];
     asm volatile(
@@ -132,6 +177,26 @@ kbool CPU::isSSE4Enabled() const
     return _SSE4;
 }
 
+kbool CPU::isSSE42Enabled() const
+{
+    return _SSE42;
+}
+
+kbool CPU::isAVXEnabled() const
+{
+    return _AVX;
+}
+
+kbool CPU::isAVX2Enabled() const
+{
+    return _AVX2;
+}
+
+kbool CPU::isAVX512Enabled() const
+{
+    return _AVX512;
+}
+
 kbool CPU::is3DNowEnabled() const
 {
     return _3DNow;
@@ -146,3 +211,29 @@ const kchar* CPU::getVendorString() const
 {
     return _vendorString;
 }
+
+kuint CPU::getFeatures() const
+{
+    kuint features = NoFeature;
+    features |= _MMX ? MMX : NoFeature;
+    features |= _SSE ? SSE : NoFeature;
+    features |= _SSE2 ? SSE2 : NoFeature;
+    features |= _SSE3 ? SSE3 : NoFeature;
+    features |= _SSE4 ? SSE4 : NoFeature;
+    features |= _SSE42 ? SSE42 : NoFeature;
+    features |= _AVX ? AVX : NoFeature;
+    features |= _AVX2 ? AVX2 : NoFeature;
+    features |= _AVX512 ? AVX512 : NoFeature;
+    return features;
+}
+
+kbool CPU::hasFeatures( kuint features ) const
+{
+    return ( getFeatures() & features ) == features;
+}
+
+const CPU& CPU::Host()
+{
+    static const CPU Instance;
+    return Instance;
+}
@@ -36,12 +36,25 @@ using namespace Kore::system;
 #define SSE3_SUPPORTED			0x00000001
 #define SSE3_EX_SUPPORTED		0x00000200
 #define SSE4_SUPPORTED			0x00080000
+#define SSE42_SUPPORTED			0x00100000
+#define OSXSAVE_SUPPORTED		0x08000000
+#define AVX_SUPPORTED			0x10000000
 #define AMD_3DNOW_SUPPORTED		0x80000000
 
+// bit flags set by cpuid in ebx when called with eax set to 7 and ecx to 0
+#define AVX2_SUPPORTED			0x00000020
+#define AVX512F_SUPPORTED		0x00010000
+
+// register states the OS saves on context switches (XCR0)
+#define XCR0_AVX_STATE			0x00000006
+#define XCR0_AVX512_STATE		0x000000E6
+
 // AMD specific
 #define AMD_3DNOW_EX_SUPPORTED	0x40000000
 #define AMD_MMX_EX_SUPPORTED	0x00400000
 
+#include <QtCore/QThread>
+
 #include <intrin.h>
 #include <cstring>
 using namespace std;
@@ -54,6 +67,9 @@ CPU::~CPU() {
 }
 
 void CPU::init() {
+	// Logical processors count (Qt knows how to ask the OS for that one).
+	_cpusCount = K_MAX( QThread::idealThreadCount(), 1 );
+
 	// Get the parameters.
 	int registers[4];
 	__cpuid(registers, 0x00000001);
@@ -63,8 +79,26 @@ void CPU::init() {
 	_SSE2 =	registers[3] & SSE2_SUPPORTED;
 	_SSE3 = registers[2] & SSE3_SUPPORTED;
 	_SSE4 = registers[2] & SSE4_SUPPORTED;
+	_SSE42 = registers[2] & SSE42_SUPPORTED;
 	_3DNow = registers[3] & AMD_3DNOW_SUPPORTED;
 
+	// The AVX registers are only usable if the OS saves them.
+	unsigned __int64 xcr0 = 0;
+	if(registers[2] & OSXSAVE_SUPPORTED) {
+		xcr0 = _xgetbv(0);
+	}
+
+	_AVX = (registers[2] & AVX_SUPPORTED) && (xcr0 & XCR0_AVX_STATE) == XCR0_AVX_STATE;
+	_AVX2 = false;
+	_AVX512 = false;
+
+	__cpuid(registers, 0x00000000);
+	if(registers[0] >= 7) {
+		__cpuidex(registers, 7, 0);
+		_AVX2 = _AVX && (registers[1] & AVX2_SUPPORTED);
+		_AVX512 = (registers[1] & AVX512F_SUPPORTED) && (xcr0 & XCR0_AVX512_STATE) == XCR0_AVX512_STATE;
+	}
+
 	// Vendor string.
 	for(int i = 0; i < 13; i++) {
 		_vendorString[i] = 0x00;
@@ -99,6 +133,22 @@ kbool	CPU::isSSE4Enabled() const {
 	return _SSE4;
 }
 
+kbool	CPU::isSSE42Enabled() const {
+	return _SSE42;
+}
+
+kbool	CPU::isAVXEnabled() const {
+	return _AVX;
+}
+
+kbool	CPU::isAVX2Enabled() const {
+	return _AVX2;
+}
+
+kbool	CPU::isAVX512Enabled() const {
+	return _AVX512;
+}
+
 kbool	CPU::is3DNowEnabled() const {
 	return _3DNow;
 }
@@ -110,3 +160,26 @@ kbool	CPU::is3DNow2Enabled() const {
 const kchar* CPU::getVendorString() const {
 	return _vendorString;
 }
+
+kuint	CPU::getFeatures() const {
+	kuint features = NoFeature;
+	features |= _MMX ? MMX : NoFeature;
+	features |= _SSE ? SSE : NoFeature;
+	features |= _SSE2 ? SSE2 : NoFeature;
+	features |= _SSE3 ? SSE3 : NoFeature;
+	features |= _SSE4 ? SSE4 : NoFeature;
+	features |= _SSE42 ? SSE42 : NoFeature;
+	features |= _AVX ? AVX : NoFeature;
+	features |= _AVX2 ? AVX2 : NoFeature;
+	features |= _AVX512 ? AVX512 : NoFeature;
+	return features;
+}
+
+kbool	CPU::hasFeatures(kuint features) const {
+	return (getFeatures() & features) == features;
+}
+
+const CPU& CPU::Host() {
+	static const CPU Instance;
+	return Instance;
+}
@@ -0,0 +1,75 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <KoreApplication.hpp>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QThread>
+#include <QtTest/QtTest>
+
+/*!
+ * Main function of a test case, running it within a KoreApplication.
+ */
+#define KORE_TEST_MAIN( TestCase ) \
+    int main( int argc, char** argv ) \
+    { \
+        QCoreApplication app( argc, argv ); \
+        Kore::KoreApplication kore( argc, argv ); \
+        TestCase tc; \
+        return QTest::qExec( &tc, argc, argv ); \
+    }
+
+namespace KoreTest {
+
+/*!
+ * Poll a condition until it holds, processing the events meanwhile.
+ * @param condition a functor returning true once the condition holds.
+ * @param timeout the maximum time to wait in ms.
+ * @return true if the condition holds, false if the wait timed out.
+ */
+template< typename Condition >
+bool WaitFor( Condition condition, int timeout = 5000 )
+{
+    QElapsedTimer clock;
+    clock.start();
+    while( ! condition() )
+    {
+        if( clock.elapsed() > timeout )
+        {
+            return false;
+        }
+        QCoreApplication::processEvents();
+        QTest::qSleep( 1 );
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,166 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <KoreTest.hpp>
+
+#include <KoreEngine.hpp>
+using namespace Kore;
+
+#include <parallel/CancellationToken.hpp>
+#include <parallel/CoroutineTasklet.hpp>
+using namespace Kore::parallel;
+
+#include <QtCore/QAtomicInt>
+
+namespace {
+
+struct Finished
+{
+    Finished( const Tasklet* t ) : tasklet( t ) {}
+    bool operator()() const { return tasklet->isFinished(); }
+    const Tasklet* tasklet;
+};
+
+struct IsSet
+{
+    IsSet( const QAtomicInt& f ) : flag( f ) {}
+    bool operator()() const { return flag != 0; }
+    const QAtomicInt& flag;
+};
+
+/*
+ * Runs until it is canceled.
+ */
+class EndlessTasklet : public Tasklet
+{
+public:
+    virtual void run( Tasklet* tasklet ) const
+    {
+        EndlessTasklet* endless = static_cast< EndlessTasklet* >( tasklet );
+        start( endless );
+        while( endless->keepRunning() )
+        {
+            QTest::qSleep( 1 );
+        }
+        TaskletRunner::cancel( endless );
+    }
+};
+
+/*
+ * Sleeps, then runs the given tasklet if any.
+ */
+class SleepingTasklet : public CoroutineTasklet
+{
+public:
+    SleepingTasklet( kint msecs, Tasklet* awaited = K_NULL )
+        : _msecs( msecs )
+        , _awaited( awaited )
+        , awaitedState( NotStarted )
+    {
+    }
+
+protected:
+    virtual Coroutine execute()
+    {
+        suspended.fetchAndStoreOrdered( 1 );
+        co_await delay( _msecs );
+        if( _awaited )
+        {
+            awaitedState = co_await runTasklet( _awaited );
+        }
+    }
+
+private:
+    const kint  _msecs;
+    Tasklet*    _awaited;
+
+public:
+    QAtomicInt  suspended;
+    kint        awaitedState;
+};
+
+}
+
+class CoroutineTaskletTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void delayed()
+    {
+        SleepingTasklet tasklet( 10 );
+        KoreEngine::RunTasklet( &tasklet, TaskletRunner::Asynchronous );
+
+        QVERIFY( KoreTest::WaitFor( Finished( &tasklet ) ) );
+        QCOMPARE( tasklet.state(), Tasklet::Completed );
+    }
+
+    // The token interrupts the delay, it does not wait for the timer.
+    void tokenInterruptsDelay()
+    {
+        CancellationToken token = CancellationToken::Create();
+        SleepingTasklet tasklet( 60000 );
+        tasklet.cancellationToken( token.createChild() );
+        KoreEngine::RunTasklet( &tasklet, TaskletRunner::Asynchronous );
+
+        QVERIFY( KoreTest::WaitFor( IsSet( tasklet.suspended ) ) );
+        token.cancel();
+
+        QVERIFY( KoreTest::WaitFor( Finished( &tasklet ) ) );
+        QCOMPARE( tasklet.state(), Tasklet::Canceled );
+    }
+
+    // Canceling the coroutine cancels the tasklet it awaits.
+    void cancelInterruptsTasklet()
+    {
+        EndlessTasklet endless;
+        SleepingTasklet tasklet( 0, &endless );
+        KoreEngine::RunTasklet( &tasklet, TaskletRunner::Asynchronous );
+
+        QVERIFY( KoreTest::WaitFor( IsSet( tasklet.suspended ) ) );
+        QVERIFY( KoreTest::WaitFor( Running( &endless ) ) );
+        tasklet.cancel();
+
+        QVERIFY( KoreTest::WaitFor( Finished( &tasklet ) ) );
+        QCOMPARE( tasklet.state(), Tasklet::Canceled );
+        QVERIFY( endless.waitForFinished() );
+        QCOMPARE( endless.state(), Tasklet::Canceled );
+    }
+
+private:
+    struct Running
+    {
+        Running( const Tasklet* t ) : tasklet( t ) {}
+        bool operator()() const { return tasklet->isRunning(); }
+        const Tasklet* tasklet;
+    };
+};
+
+KORE_TEST_MAIN( CoroutineTaskletTest )
+
+#include "CoroutineTaskletTest.moc"
@@ -0,0 +1,146 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <KoreTest.hpp>
+
+#include <KoreEngine.hpp>
+using namespace Kore;
+
+#include <parallel/PipelineTasklet.hpp>
+#include <parallel/TaskletObserver.hpp>
+using namespace Kore::parallel;
+
+#include <QtCore/QAtomicInt>
+
+namespace {
+
+/*
+ * A single stage pipeline whose producer starves until it is exhausted.
+ */
+class StarvedPipeline : public PipelineTasklet
+{
+public:
+    StarvedPipeline()
+    {
+        appendStage( 1, DefaultCapacity );
+    }
+
+    void finish()
+    {
+        exhaust();
+    }
+
+protected:
+    virtual Step step( kint )
+    {
+        return Starved;
+    }
+
+    virtual QString stageName( kint ) const
+    {
+        return "Starved";
+    }
+
+    virtual void clear()
+    {
+    }
+};
+
+/*
+ * Counts the ends of the tasklets it observes.
+ */
+class EndCounter : public TaskletObserver
+{
+public:
+    virtual void taskletEnded( Tasklet*, kint )
+    {
+        ends.ref();
+    }
+
+public:
+    QAtomicInt ends;
+};
+
+}
+
+class PipelineTaskletTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    // Exhausting the pipeline while its first stage is being parked ends it
+    // exactly once.
+    void exhaustStarved()
+    {
+        for( kint i = 0; i < 1000; ++i )
+        {
+            EndCounter counter;
+            StarvedPipeline pipeline;
+            pipeline.headless( true );
+            pipeline.addObserver( &counter );
+
+            KoreEngine::RunTasklet( &pipeline, TaskletRunner::Asynchronous );
+            if( i % 2 )
+            {
+                QThread::yieldCurrentThread();
+            }
+            pipeline.finish();
+
+            QVERIFY( pipeline.waitForFinished( 5000 ) );
+            QCOMPARE( pipeline.state(), Tasklet::Completed );
+            QCOMPARE( static_cast< kint >( counter.ends ), 1 );
+        }
+    }
+
+    // Likewise when it is canceled.
+    void cancelStarved()
+    {
+        for( kint i = 0; i < 1000; ++i )
+        {
+            EndCounter counter;
+            StarvedPipeline pipeline;
+            pipeline.headless( true );
+            pipeline.addObserver( &counter );
+
+            KoreEngine::RunTasklet( &pipeline, TaskletRunner::Asynchronous );
+            if( i % 2 )
+            {
+                QThread::yieldCurrentThread();
+            }
+            pipeline.cancel();
+
+            QVERIFY( pipeline.waitForFinished( 5000 ) );
+            QVERIFY( pipeline.state() != Tasklet::Completed );
+            QCOMPARE( static_cast< kint >( counter.ends ), 1 );
+        }
+    }
+};
+
+KORE_TEST_MAIN( PipelineTaskletTest )
+
+#include "PipelineTaskletTest.moc"
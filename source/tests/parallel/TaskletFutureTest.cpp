@@ -0,0 +1,142 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <KoreTest.hpp>
+
+#include <KoreEngine.hpp>
+#include <KoreModule.hpp>
+using namespace Kore;
+
+#include <parallel/Tasklet.hpp>
+#include <parallel/TaskletFutureT.hpp>
+#include <parallel/TaskletMacros.hpp>
+using namespace Kore::parallel;
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QThread>
+
+namespace {
+
+QAtomicInt Displayed;
+QThread* DisplayThread = K_NULL;
+
+struct Scaler
+{
+    Scaler( kint factor ) : factor( factor ) {}
+    kint operator()( const kint& value ) const { return value * factor; }
+    kint factor;
+};
+
+void Display( const kint& value )
+{
+    DisplayThread = QThread::currentThread();
+    Displayed.fetchAndStoreOrdered( value );
+}
+
+struct IsFinished
+{
+    IsFinished( const TaskletFuture& f ) : future( f ) {}
+    bool operator()() const { return future.isFinished(); }
+    const TaskletFuture& future;
+};
+
+}
+
+/*
+ * Produces its value right away.
+ */
+class DecoderTasklet : public Tasklet
+{
+    Q_OBJECT
+    K_TASKLET
+
+public:
+    DecoderTasklet() : _value( 0 ) {}
+
+    kint result() const { return _value; }
+
+    virtual void run( Tasklet* tasklet ) const
+    {
+        start( tasklet );
+        static_cast< DecoderTasklet* >( tasklet )->_value = 21;
+        complete( tasklet );
+    }
+
+private:
+    kint _value;
+};
+
+K_TASKLET_I( DecoderTasklet )
+
+class TaskletFutureTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    // The example of the documentation of TaskletFutureT.
+    void thenVoid()
+    {
+        DecoderTasklet* decoder = new DecoderTasklet;
+        decoder->headless( true );
+
+        TaskletFutureT< kint > image = TaskletFutureT< kint >::Of( decoder );
+        TaskletFutureT< kint > thumbnail = image.then< kint >( Scaler( 2 ) );
+        TaskletFutureT< void > displayed =
+                thumbnail.then( &Display,
+                                QCoreApplication::instance()->thread() );
+        KoreEngine::RunTasklet( decoder, TaskletRunner::Asynchronous );
+
+        QVERIFY( KoreTest::WaitFor( IsFinished( displayed ) ) );
+        QVERIFY( displayed.isCompleted() );
+        QCOMPARE( static_cast< kint >( Displayed ), 42 );
+        QCOMPARE( DisplayThread, QCoreApplication::instance()->thread() );
+        QCOMPARE( thumbnail.result(), 42 );
+
+        decoder->waitForFinished();
+        delete decoder;
+    }
+
+    // A tasklet destroyed before it ended cancels its future.
+    void destroyedUnrun()
+    {
+        DecoderTasklet* decoder = new DecoderTasklet;
+        TaskletFutureT< kint > value = TaskletFutureT< kint >::Of( decoder );
+        TaskletFutureT< void > chained = value.then< void >( Scaler( 2 ) );
+        delete decoder;
+
+        QVERIFY( value.isFinished() );
+        QCOMPARE( value.state(), static_cast< kint >( Tasklet::Canceled ) );
+        QCOMPARE( value.result(), 0 );
+        QVERIFY( chained.isFinished() );
+        QVERIFY( ! chained.isCompleted() );
+    }
+};
+
+KORE_TEST_MAIN( TaskletFutureTest )
+
+#include "TaskletFutureTest.moc"
@@ -0,0 +1,264 @@
+/*
+ * 	Copyright (c) 2010-2011, Romuald CARI
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the <organization> nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL Romuald CARI BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <KoreTest.hpp>
+
+#include <KoreEngine.hpp>
+#include <KoreModule.hpp>
+using namespace Kore;
+
+#include <parallel/Tasklet.hpp>
+#include <parallel/TaskletMacros.hpp>
+#include <parallel/TaskletScheduler.hpp>
+using namespace Kore::parallel;
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
+
+namespace {
+
+/*
+ * Counts its runs, batched or not, and the runs of a tasklet overlapping one
+ * another.
+ */
+class CountingRunner : public TaskletRunner
+{
+public:
+    CountingRunner( QAtomicInt& runs, kint batchSize, kint score )
+        : _runs( runs )
+        , _batchSize( batchSize )
+        , _score( score )
+    {
+    }
+
+    virtual QString runnerName() const { return "Counting runner"; }
+    virtual kint performanceScore() const { return _score; }
+    virtual kint maxBatchSize() const { return _batchSize; }
+
+    virtual void run( Tasklet* tasklet ) const
+    {
+        _runningMutex.lock();
+        if( _running.contains( tasklet ) )
+        {
+            overlaps.ref();
+        }
+        _running.insert( tasklet );
+        _runningMutex.unlock();
+
+        start( tasklet );
+        _runs.ref();
+
+        _runningMutex.lock();
+        _running.remove( tasklet );
+        _runningMutex.unlock();
+
+        complete( tasklet );
+    }
+
+    virtual void runBatch( const QList< Tasklet* >& tasklets ) const
+    {
+        batches.ref();
+        if( tasklets.toSet().size() < tasklets.size() )
+        {
+            overlaps.ref();
+        }
+        TaskletRunner::runBatch( tasklets );
+    }
+
+public:
+    mutable QAtomicInt batches;
+    mutable QAtomicInt overlaps;
+
+private:
+    QAtomicInt& _runs;
+    const kint _batchSize;
+    const kint _score;
+    mutable QMutex _runningMutex;
+    mutable QSet< Tasklet* > _running;
+};
+
+struct AtLeast
+{
+    AtLeast( const QAtomicInt& c, kint v ) : counter( c ), value( v ) {}
+    bool operator()() const { return counter >= value; }
+    const QAtomicInt& counter;
+    const kint value;
+};
+
+struct Finished
+{
+    Finished( const Tasklet* t ) : tasklet( t ) {}
+    bool operator()() const { return tasklet->isFinished(); }
+    const Tasklet* tasklet;
+};
+
+}
+
+/*
+ * Of a type whose runner fuses the runs into batches.
+ */
+class BatchedTasklet : public Tasklet
+{
+    Q_OBJECT
+    K_TASKLET
+};
+
+K_TASKLET_I( BatchedTasklet )
+
+/*
+ * Of a type whose runs are hedged.
+ */
+class HedgedTasklet : public Tasklet
+{
+    Q_OBJECT
+    K_TASKLET
+
+protected:
+    virtual Tasklet* hedgedCopy() const
+    {
+        return new HedgedTasklet;
+    }
+};
+
+K_TASKLET_I( HedgedTasklet )
+
+class TaskletTimersTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    TaskletTimersTest()
+        : _batchRunner( _batchedRuns, 8, 1 )
+        , _hedgeRunner( _hedgedRuns, 1, 2 )
+        , _hedgingRunner( _hedgedRuns, 1, 1 )
+    {
+    }
+
+private slots:
+    void initTestCase()
+    {
+        KoreEngine::RegisterTaskletRunner< BatchedTasklet >( &_batchRunner );
+        KoreEngine::RegisterTaskletRunner< HedgedTasklet >( &_hedgeRunner );
+        KoreEngine::RegisterTaskletRunner< HedgedTasklet >( &_hedgingRunner );
+
+        MetaTasklet* batched =
+                static_cast< MetaTasklet* >( BatchedTasklet::StaticMetaBlock() );
+        batched->batching( 8, 5 );
+
+        MetaTasklet* hedged =
+                static_cast< MetaTasklet* >( HedgedTasklet::StaticMetaBlock() );
+        hedged->hedgingPercentile( 50 );
+    }
+
+    // A periodic tasklet joining a batch arms a timer from the timer thread.
+    void everyBatched()
+    {
+        BatchedTasklet tasklet;
+        tasklet.headless( true );
+
+        const kint timer = KoreEngine::RunTaskletEvery( &tasklet, 2 );
+        QVERIFY( KoreTest::WaitFor( AtLeast( _batchedRuns, 5 ) ) );
+        QVERIFY( _batchRunner.batches > 0 );
+        QVERIFY( KoreEngine::CancelTimer( timer ) );
+
+        // Waiting in a batch, it was not submitted again meanwhile.
+        QCOMPARE( static_cast< kint >( _batchRunner.overlaps ), 0 );
+
+        QVERIFY( KoreTest::WaitFor( Finished( &tasklet ) ) );
+        checkTimersAlive();
+    }
+
+    // Canceling a periodic tasklet between two of its runs stops its timer.
+    void everyCanceled()
+    {
+        BatchedTasklet tasklet;
+        tasklet.headless( true );
+
+        const kint runs = _batchedRuns;
+        const kint timer = KoreEngine::RunTaskletEvery( &tasklet, 20 );
+        QVERIFY( KoreTest::WaitFor( AtLeast( _batchedRuns, runs + 2 ) ) );
+        QVERIFY( KoreTest::WaitFor( Finished( &tasklet ) ) );
+        tasklet.cancel();
+
+        // At most the occurrence submitted meanwhile.
+        const kint canceled = _batchedRuns;
+        QTest::qWait( 100 );
+        QVERIFY( _batchedRuns <= canceled + 1 );
+        QVERIFY( ! KoreEngine::CancelTimer( timer ) );
+
+        QVERIFY( KoreTest::WaitFor( Finished( &tasklet ) ) );
+        checkTimersAlive();
+    }
+
+    // A periodic hedged tasklet adds the timer of its hedge from the timer
+    // thread.
+    void everyHedged()
+    {
+        // Enough measured runs for the tasklets of the type to be hedged.
+        HedgedTasklet warmup;
+        for( kint i = 0; i < 2 * MetaTasklet::HedgingWindow; ++i )
+        {
+            KoreEngine::RunTasklet( &warmup, TaskletRunner::Synchronous );
+        }
+        const kint runs = _hedgedRuns;
+
+        HedgedTasklet tasklet;
+        tasklet.headless( true );
+
+        const kint timer = KoreEngine::RunTaskletEvery( &tasklet, 2 );
+        QVERIFY( KoreTest::WaitFor( AtLeast( _hedgedRuns, runs + 5 ) ) );
+        QVERIFY( KoreEngine::CancelTimer( timer ) );
+
+        QVERIFY( KoreTest::WaitFor( Finished( &tasklet ) ) );
+        checkTimersAlive();
+    }
+
+private:
+    // The timer thread still serves the other timers.
+    void checkTimersAlive()
+    {
+        const kint runs = _batchedRuns;
+        BatchedTasklet tasklet;
+        tasklet.headless( true );
+        KoreEngine::RunTaskletAfter( &tasklet, 1 );
+        QVERIFY( KoreTest::WaitFor( AtLeast( _batchedRuns, runs + 1 ) ) );
+        QVERIFY( KoreTest::WaitFor( Finished( &tasklet ) ) );
+    }
+
+private:
+    QAtomicInt _batchedRuns;
+    QAtomicInt _hedgedRuns;
+    CountingRunner _batchRunner;
+    CountingRunner _hedgeRunner;
+    CountingRunner _hedgingRunner;
+};
+
+KORE_TEST_MAIN( TaskletTimersTest )
+
+#include "TaskletTimersTest.moc"